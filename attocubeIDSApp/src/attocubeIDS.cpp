@@ -1,36 +1,83 @@
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string_view>
 
+#include <alarm.h>
 #include <asynOctetSyncIO.h>
+#include <epicsExit.h>
 #include <epicsExport.h>
+#include <epicsStdio.h>
 #include <epicsThread.h>
 #include <iocsh.h>
 
 #include "attocubeIDS.hpp"
 
-static void poll_thread_C(void* pPvt) {
-    AttocubeIDS* pAttocubeIDS = (AttocubeIDS*)pPvt;
-    pAttocubeIDS->poll();
-}
-
 constexpr int MAX_CONTROLLERS = 1;
 constexpr int INTERFACE_MASK = asynInt32Mask | asynInt64Mask | asynFloat64Mask | asynOctetMask | asynDrvUserMask;
 constexpr int INTERRUPT_MASK = asynInt32Mask | asynInt64Mask | asynFloat64Mask | asynOctetMask;
 constexpr int ASYN_FLAGS = ASYN_MULTIDEVICE | ASYN_CANBLOCK;
 
-AttocubeIDS::AttocubeIDS(const char* conn_port, const char* driver_port)
-    : asynPortDriver(driver_port, MAX_CONTROLLERS, INTERFACE_MASK, INTERRUPT_MASK, ASYN_FLAGS, 1, 0, 0) {
+// every port, for the AttocubeIDSWaitInit barrier
+static std::mutex init_mutex;
+static std::condition_variable init_changed;
+static std::vector<AttocubeIDS*> instances;
 
-    asynStatus status = pasynOctetSyncIO->connect(conn_port, 0, &pasynUserDriver_, NULL);
-    pasynOctetSyncIO->setInputEos(pasynUserDriver_, "\n", 1);
-    if (status) {
-        asynPrint(pasynUserDriver_, ASYN_TRACE_ERROR, "Failed to connect to Attocube IDS3010\n");
-        return;
+static int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+AttocubeIDS::AttocubeIDS(const char* conn_port, const char* driver_port, Transport transport,
+                         size_t connections)
+    : asynPortDriver(driver_port, MAX_CONTROLLERS, INTERFACE_MASK, INTERRUPT_MASK, ASYN_FLAGS, 1, 0, 0),
+      conn_port_(conn_port ? conn_port : ""), transport_(transport), executor_(Executor::shared()) {
+
+    hook_interrupts();
+    // the connection is made by the first poll cycle, so nothing here waits for the controller
+    if (transport_ == Transport::Native) {
+        for (size_t i = 0; i < std::max<size_t>(connections, 1); i++) {
+            links_.push_back(std::make_unique<Link>());
+            links_.back()->port = conn_port_;
+        }
+    } else {
+        size_t start = 0;
+        do {
+            size_t comma = conn_port_.find(',', start);
+            links_.push_back(std::make_unique<Link>());
+            links_.back()->port = conn_port_.substr(start, comma - start);
+            start = comma == std::string::npos ? comma : comma + 1;
+        } while (start != std::string::npos);
+    }
+    {
+        std::lock_guard<std::mutex> guard(init_mutex);
+        instances.push_back(this);
     }
 
     createParam(START_MEASUREMENT_STR, asynParamInt32, &startMeasurementId_);
     createParam(STOP_MEASUREMENT_STR, asynParamInt32, &stopMeasurementId_);
+    createParam(CMD_LATENCY_STR, asynParamFloat64, &cmdLatencyId_);
+    createParam(CMD_ERR_NO_STR, asynParamInt32, &cmdErrNoId_);
+    createParam(PUBLISH_RATE_STR, asynParamFloat64, &publishRateId_);
+    createParam(PUBLISH_MODE_STR, asynParamInt32, &publishModeId_);
+    setDoubleParam(publishRateId_, 0.0);
+    setIntegerParam(publishModeId_, static_cast<int>(PublishMode::Latest));
+    for (size_t error = 1; error < RpcCodec::NUM_RPC_ERRORS; error++) {
+        createParam(RPC_ERRORS_STR[error], asynParamInt32, &rpcErrorsId_[error]);
+        setIntegerParam(rpcErrorsId_[error], 0);
+    }
+    createParam(RPC_LAST_ERR_CODE_STR, asynParamInt32, &rpcLastErrCodeId_);
+    createParam(RPC_LAST_ERR_MSG_STR, asynParamOctet, &rpcLastErrMsgId_);
+    setIntegerParam(rpcLastErrCodeId_, 0);
+    setStringParam(rpcLastErrMsgId_, "");
+    createParam(HEARTBEAT_AGE_STR, asynParamFloat64, &heartbeatAgeId_);
+    createParam(STALL_COUNT_STR, asynParamInt32, &stallCountId_);
+    setDoubleParam(heartbeatAgeId_, 0.0);
+    setIntegerParam(stallCountId_, 0);
     createParam(RESUME_POLLER_STR, asynParamInt32, &resumePollerId_);
     createParam(SUSPEND_POLLER_STR, asynParamInt32, &suspendPollerId_);
     createParam(POLL_PERIOD_STR, asynParamFloat64, &pollPeriodId_);
@@ -38,125 +85,934 @@ AttocubeIDS::AttocubeIDS(const char* conn_port, const char* driver_port)
     createParam(CURRENT_MODE_STR, asynParamOctet, &currentModeId_);
     createParam(DEVICE_TYPE_STR, asynParamOctet, &deviceTypeId_);
     createParam(FPGA_VERSION_STR, asynParamOctet, &fpgaVersionId_);
-    createParam(AXIS0_DISPLACEMENT_STR, asynParamInt64, &axis0DisplacementId_);
-    createParam(AXIS1_DISPLACEMENT_STR, asynParamInt64, &axis1DisplacementId_);
-    createParam(AXIS2_DISPLACEMENT_STR, asynParamInt64, &axis2DisplacementId_);
-    createParam(AXIS0_ABSOLUTE_POS_STR, asynParamInt64, &axis0AbsolutePosId_);
-    createParam(AXIS1_ABSOLUTE_POS_STR, asynParamInt64, &axis1AbsolutePosId_);
-    createParam(AXIS2_ABSOLUTE_POS_STR, asynParamInt64, &axis2AbsolutePosId_);
-    createParam(AXIS0_REFERENCE_POS_STR, asynParamInt64, &axis0ReferencePosId_);
-    createParam(AXIS1_REFERENCE_POS_STR, asynParamInt64, &axis1ReferencePosId_);
-    createParam(AXIS2_REFERENCE_POS_STR, asynParamInt64, &axis2ReferencePosId_);
+    setStringParam(deviceTypeId_, "");
+    setStringParam(fpgaVersionId_, "");
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        createParam(AXIS_DISPLACEMENT_STR[axis], asynParamInt64, &axisDisplacementId_[axis]);
+        createParam(AXIS_ABSOLUTE_POS_STR[axis], asynParamInt64, &axisAbsolutePosId_[axis]);
+        createParam(AXIS_REFERENCE_POS_STR[axis], asynParamInt64, &axisReferencePosId_[axis]);
+    }
+
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        createParam(AXIS_SCALE_STR[axis], asynParamFloat64, &axisScaleId_[axis]);
+        createParam(AXIS_OFFSET_STR[axis], asynParamFloat64, &axisOffsetId_[axis]);
+        createParam(AXIS_POLY2_STR[axis], asynParamFloat64, &axisPoly2Id_[axis]);
+        createParam(AXIS_POLY3_STR[axis], asynParamFloat64, &axisPoly3Id_[axis]);
+        createParam(AXIS_DISPLACEMENT_EGU_STR[axis], asynParamFloat64, &axisDisplacementEguId_[axis]);
+        createParam(AXIS_ABSOLUTE_POS_EGU_STR[axis], asynParamFloat64, &axisAbsolutePosEguId_[axis]);
+        setDoubleParam(axisScaleId_[axis], conversion_.scale[axis]);
+        setDoubleParam(axisOffsetId_[axis], conversion_.offset[axis]);
+        setDoubleParam(axisPoly2Id_[axis], conversion_.poly2[axis]);
+        setDoubleParam(axisPoly3Id_[axis], conversion_.poly3[axis]);
+    }
+
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        createParam(AXIS_VELOCITY_STR[axis], asynParamFloat64, &axisVelocityId_[axis]);
+        createParam(AXIS_ACCELERATION_STR[axis], asynParamFloat64, &axisAccelerationId_[axis]);
+    }
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        createParam(AXIS_FILTER_STR[axis], asynParamOctet, &axisFilterId_[axis]);
+        createParam(AXIS_FILTERED_STR[axis], asynParamFloat64, &axisFilteredId_[axis]);
+        setStringParam(axisFilterId_[axis], "");
+    }
+    createParam(EST_MODE_STR, asynParamInt32, &estModeId_);
+    createParam(EST_WINDOW_STR, asynParamInt32, &estWindowId_);
+    createParam(EST_ALPHA_STR, asynParamFloat64, &estAlphaId_);
+    createParam(EST_BETA_STR, asynParamFloat64, &estBetaId_);
+    createParam(EST_GAMMA_STR, asynParamFloat64, &estGammaId_);
+    setIntegerParam(estModeId_, MotionEstimator<MAX_EST_WINDOW>::FiniteDifference);
+    setIntegerParam(estWindowId_, 4);
+    setDoubleParam(estAlphaId_, 0.5);
+    setDoubleParam(estBetaId_, 0.1);
+    setDoubleParam(estGammaId_, 0.01);
+    configure_estimators();
+
+    for (size_t slot = 0; slot < MAX_DERIVED; slot++) {
+        char name[32];
+        snprintf(name, sizeof(name), DERIVED_VALUE_FMT, slot);
+        createParam(name, asynParamFloat64, &derivedValueId_[slot]);
+        snprintf(name, sizeof(name), DERIVED_EXPR_FMT, slot);
+        createParam(name, asynParamOctet, &derivedExprId_[slot]);
+        setStringParam(derivedExprId_[slot], "");
+    }
+
+    createParam(AXIS_ENABLE_STR, asynParamInt32, &axisEnableId_);
+    set_axis_enable(ALL_AXES);
 
-    // Get some parameters that won't change at runtime
-    if (auto devtype = do_rpc<StringTuple>(Method::DeviceType); devtype) {
-	setStringParam(deviceTypeId_, std::get<0>(*devtype));
+    // Results of every poll cycle, published at PUBLISH_RATE
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        for (int id : {axisDisplacementId_[axis], axisAbsolutePosId_[axis], axisReferencePosId_[axis]})
+            published_.add_param(id, true);
+        for (int id : {axisDisplacementEguId_[axis], axisAbsolutePosEguId_[axis], axisVelocityId_[axis],
+                       axisAccelerationId_[axis], axisFilteredId_[axis]})
+            published_.add_param(id, false);
     }
-    if (auto fpga_ver = do_rpc<StringTuple>(Method::FpgaVersion); fpga_ver) {
-	setStringParam(fpgaVersionId_, std::get<0>(*fpga_ver));
+    for (size_t slot = 0; slot < MAX_DERIVED; slot++)
+        published_.add_param(derivedValueId_[slot], false);
+
+    // Additional device quantities, only fetched while a client is interested in them
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        add_quantity<Method::AxisSignalQuality, 1, 2>(FetchPolicy::Subscribed, 0.0,
+                                                      {AXIS_CONTRAST_STR[axis], AXIS_BASELINE_STR[axis]},
+                                                      static_cast<int>(axis));
+        quantities_.back().axis = static_cast<int>(axis);
     }
+    add_quantity<Method::AdjustmentEnabled, 1>(FetchPolicy::Periodic, 1.0, {ADJUSTMENT_ENABLED_STR});
+    add_quantity<Method::EcuConnected, 1>(FetchPolicy::Periodic, 5.0, {ECU_CONNECTED_STR});
+    add_quantity<Method::EcuTemperature, 1>(FetchPolicy::Periodic, 2.0, {ECU_TEMPERATURE_STR});
+    add_quantity<Method::EcuHumidity, 1>(FetchPolicy::Periodic, 2.0, {ECU_HUMIDITY_STR});
+    add_quantity<Method::EcuPressure, 1>(FetchPolicy::Periodic, 2.0, {ECU_PRESSURE_STR});
+    add_quantity<Method::EcuRefractiveIndex, 1>(FetchPolicy::Periodic, 2.0, {ECU_REFRACTIVE_INDEX_STR});
+    add_quantity<Method::PilotLaserEnabled, 1>(FetchPolicy::OnDemand, 0.0, {PILOT_LASER_ENABLED_STR});
+
+    // all params exist now, size the interest counters before any client can bind
+    interest_.resize(quantity_of_param_.size());
+
+    // what the watchdog marks INVALID when the poller stalls
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        data_params_.insert(data_params_.end(),
+                            {axisDisplacementId_[axis], axisAbsolutePosId_[axis], axisReferencePosId_[axis],
+                             axisDisplacementEguId_[axis], axisAbsolutePosEguId_[axis], axisVelocityId_[axis],
+                             axisAccelerationId_[axis], axisFilteredId_[axis]});
+    }
+    data_params_.insert(data_params_.end(), derivedValueId_.begin(), derivedValueId_.end());
+    data_params_.insert(data_params_.end(), {measurementEnabledId_, currentModeId_});
+    for (const auto& q : quantities_)
+        data_params_.insert(data_params_.end(), q.params.begin(), q.params.end());
+
+    // one timer thread watches all ports, a stalled poller cannot hold it up
+    static epicsTimerQueueId watchdog_queue = epicsTimerQueueAllocate(1, epicsThreadPriorityScanLow);
+    watchdog_timer_ = epicsTimerQueueCreateTimer(
+        watchdog_queue, [](void* ids) { static_cast<AttocubeIDS*>(ids)->check_heartbeat(); }, this);
 
-    poller_thread_id_ = epicsThreadCreate("AttocubeIDSPoller", epicsThreadPriorityLow,
-                                          epicsThreadGetStackSize(epicsThreadStackMedium),
-                                          (EPICSTHREADFUNC)poll_thread_C, this);
+    start();
+    // exit hooks run in reverse order, so the logger flushes after stop() has logged
+    Logger::shared();
+    epicsAtExit([](void* ids) { static_cast<AttocubeIDS*>(ids)->stop(SHUTDOWN_TIMEOUT); }, this);
 }
 
-asynStatus AttocubeIDS::write_read(size_t write_len) {
-    nbytesout_ = 0;
-    nbytesin_ = 0;
-    eom_reason_ = 0;
-    asynStatus status =
-        pasynOctetSyncIO->writeRead(pasynUserDriver_, out_buffer_.data(), write_len, in_buffer_.data(),
-                                    in_buffer_.size(), IO_TIMEOUT, &nbytesout_, &nbytesin_, &eom_reason_);
+bool AttocubeIDS::start() {
+    lock();
+    // a timed out stop() is still waiting for its cycle, which completes the stop when it ends
+    if (acquiring_ && stopping_) {
+        unlock();
+        return false;
+    }
+    if (!acquiring_) {
+        acquiring_ = true;
+        stopping_ = false;
+        poller_should_suspend_ = false;
+        poller_suspended_ = false;
+        heartbeat_ns_ = steady_ns();
+        watching_ = true;
+        executor_.submit([this, generation = ++poll_generation_] { poll(generation); });
+        double publish_rate;
+        getDoubleParam(publishRateId_, &publish_rate);
+        if (publish_rate > 0.0)
+            executor_.submit([this, generation = ++publish_generation_] { publish(generation); });
+        epicsTimerStartDelay(watchdog_timer_, WATCHDOG_PERIOD);
+    }
+    unlock();
+    return true;
+}
 
-    if (status) {
-        asynPrint(pasynUserDriver_, ASYN_TRACE_ERROR, "AttocubeIDS::write_read() failed\n");
+bool AttocubeIDS::stop(double timeout) {
+    stopping_ = true;
+    watching_ = false;
+    epicsTimerCancel(watchdog_timer_);
+    // a cycle waiting for commands to go first stops waiting
+    command_done_.signal();
+
+    // the running cycle holds the lock until it is done, so wait for it without the lock
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+    while (cycle_active_) {
+        double left = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0.0) {
+            // the cycle clears cycle_active_ before it looks at stop_late_, so exactly one of
+            // the two completes the stop
+            stop_late_ = true;
+            if (cycle_active_ || !stop_late_.exchange(false)) {
+                Logger::shared().log(LogClass::Internal, portName,
+                                     "poll cycle did not stop within %.1f s, it completes the stop", timeout);
+                return false;
+            }
+            break;
+        }
+        cycle_done_.wait(left);
+    }
+
+    lock();
+    finish_stop();
+    unlock();
+    return true;
+}
+
+void AttocubeIDS::finish_stop() {
+    // scheduled cycles and publications find their chain gone and end
+    poll_generation_++;
+    publish_generation_++;
+    acquiring_ = false;
+    flush_published();
+    callParamCallbacks();
+    if (mcast_)
+        mcast_->flush();
+}
+
+bool AttocubeIDS::connect_transport() {
+    std::string error;
+    if (transport_ == Transport::Native) {
+        // resolving the address can take a while, commands need not wait for it
+        unlock();
+        std::vector<std::unique_ptr<NativeConnection>> conns;
+        for (size_t i = 0; i < links_.size() && error.empty(); i++)
+            conns.push_back(NativeConnection::create(conn_port_, error));
+        lock();
+        if (error.empty()) {
+            for (size_t i = 0; i < links_.size(); i++) {
+                links_[i]->native = std::move(conns[i]);
+                for (IoContext& io : links_[i]->pool.contexts())
+                    io.native = links_[i]->native.get();
+            }
+        }
+    } else {
+        // every I/O context gets its own asynUser on the port of its link, asyn serialises
+        // those of one port on the wire
+        for (auto& link : links_) {
+            for (IoContext& io : link->pool.contexts()) {
+                if (io.pasynUser)
+                    continue;
+                if (pasynOctetSyncIO->connect(link->port.c_str(), 0, &io.pasynUser, NULL)) {
+                    io.pasynUser = nullptr;
+                    error = "cannot connect to asyn port " + link->port;
+                    break;
+                }
+                pasynOctetSyncIO->setInputEos(io.pasynUser, "\n", 1);
+            }
+            if (!error.empty())
+                break;
+        }
+    }
+    if (!error.empty()) {
+        log_error(LogClass::Transport, "%s", error.c_str());
+        return false;
     }
+    connected_ = true;
+    return true;
+}
 
+bool AttocubeIDS::fetch_static_data() {
+    // an unreachable controller costs one timeout per attempt, not two
+    if (!device_type_ &&
+        !visit_rpc<Method::DeviceType>(
+            [this](const auto& devtype) { set_string_param(deviceTypeId_, std::get<0>(devtype), device_type_); }))
+        return false;
+    if (!fpga_version_) {
+        visit_rpc<Method::FpgaVersion>([this](const auto& fpga_ver) {
+            set_string_param(fpgaVersionId_, std::get<0>(fpga_ver), fpga_version_);
+        });
+    }
+    return device_type_ && fpga_version_;
+}
+
+void AttocubeIDS::mark_initialized() {
+    init_seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - created_).count();
+    {
+        std::lock_guard<std::mutex> guard(init_mutex);
+        initialized_ = true;
+    }
+    // the watchdog starts watching now, the handshake retries before do not count as a stall
+    heartbeat_ns_ = steady_ns();
+    init_changed.notify_all();
+}
+
+asynStatus AttocubeIDS::write_read(IoContext& io, size_t write_len) {
+    io.nbytesout = 0;
+    io.nbytesin = 0;
+    io.eom_reason = 0;
+    // requests before the transport is set up fail at once rather than waiting for IO_TIMEOUT
+    if (!connected_)
+        return asynDisconnected;
+    asynStatus status;
+    if (io.native) {
+        status = io.native->write_read(io.out.data(), write_len, io.in.data(), io.in.size(), IO_TIMEOUT,
+                                     &io.nbytesout, &io.nbytesin, &io.eom_reason);
+    } else {
+        status = pasynOctetSyncIO->writeRead(io.pasynUser, io.out.data(), write_len, io.in.data(), io.in.size(),
+                                             IO_TIMEOUT, &io.nbytesout, &io.nbytesin, &io.eom_reason);
+    }
+
+    log_transport_error(status);
     return status;
 }
 
-std::optional<json> AttocubeIDS::write_read_json(std::string_view method, json params) {
-    json rpc = {{"jsonrpc", "2.0"}, {"id", 1}, {"method", method}};
-    if (!params.empty())
-        rpc["params"] = params;
+void AttocubeIDS::log_transport_error(asynStatus status) {
+    if (status) {
+        log_error(LogClass::Transport, "write_read() failed: %s",
+                  status == asynTimeout ? "timeout" : status == asynOverflow ? "reply too long" : "I/O error");
+    }
+}
+
+RpcCodec::RpcError AttocubeIDS::transport_error(asynStatus status, const IoContext& io) {
+    using RpcCodec::RpcError;
+    switch (status) {
+    case asynSuccess:
+        // a reply that filled the buffer before its terminator is cut off
+        return (io.eom_reason & ASYN_EOM_EOS) ? RpcError::None : RpcError::Framing;
+    case asynTimeout:
+        return RpcError::Timeout;
+    case asynOverflow:
+        return RpcError::Framing;
+    default:
+        return RpcError::Transport;
+    }
+}
+
+void AttocubeIDS::count_rpc_error(RpcCodec::RpcError error, const RpcCodec::RemoteError& remote) {
+    rpc_errors_[static_cast<size_t>(error)].fetch_add(1, std::memory_order_relaxed);
+    if (error != RpcCodec::RpcError::Remote)
+        return;
+    std::lock_guard<std::mutex> guard(remote_error_mutex_);
+    remote_error_code_ = remote.code;
+    if (!remote.message.assign_to(remote_error_message_))
+        remote_error_message_.assign(remote.message.raw);
+    remote_error_fresh_ = true;
+}
+
+void AttocubeIDS::publish_rpc_errors() {
+    for (size_t error = 1; error < RpcCodec::NUM_RPC_ERRORS; error++)
+        setIntegerParam(rpcErrorsId_[error], static_cast<int>(rpc_errors_[error].load(std::memory_order_relaxed)));
+    std::lock_guard<std::mutex> guard(remote_error_mutex_);
+    if (remote_error_fresh_) {
+        setIntegerParam(rpcLastErrCodeId_, static_cast<int>(remote_error_code_));
+        setStringParam(rpcLastErrMsgId_, remote_error_message_);
+        remote_error_fresh_ = false;
+    }
+}
+
+double AttocubeIDS::heartbeat_age() const { return (steady_ns() - heartbeat_ns_.load()) * 1e-9; }
+
+uint32_t AttocubeIDS::link_error_count() const {
+    return rpc_errors_[static_cast<size_t>(RpcCodec::RpcError::Timeout)].load(std::memory_order_relaxed) +
+           rpc_errors_[static_cast<size_t>(RpcCodec::RpcError::Transport)].load(std::memory_order_relaxed);
+}
+
+void AttocubeIDS::check_heartbeat() {
+    double age = heartbeat_age();
+    if (watching_ && initialized_ && age > stall_timeout_) {
+        if (!stalled_.exchange(true)) {
+            stalls_++;
+            Logger::shared().log(LogClass::Internal, portName, "no poll cycle completed for %.1f s", age);
+        }
+        recover();
+    }
+    if (!stopping_)
+        epicsTimerStartDelay(watchdog_timer_, WATCHDOG_PERIOD);
+}
+
+void AttocubeIDS::recover() {
+    // a running cycle only holds the lock between its RPCs, so this does not wait for a reply
+    lock();
+    double age = heartbeat_age();
+    if (watching_ && stalled_ && age > stall_timeout_) {
+        setDoubleParam(heartbeatAgeId_, age);
+        if (!data_invalid_)
+            set_data_invalid(true);
+        callParamCallbacks();
+        // cycles that keep failing to reach the controller are left running, but if none is
+        // running and none started for as long the chain was lost; a new one takes over and the
+        // old one, should it come back, ends at its next cycle
+        if (!cycle_active_ && (steady_ns() - cycle_start_ns_) * 1e-9 > stall_timeout_)
+            executor_.submit([this, generation = ++poll_generation_] { poll(generation); });
+    }
+    unlock();
+}
+
+void AttocubeIDS::set_data_invalid(bool invalid) {
+    int status = invalid ? static_cast<int>(COMM_ALARM) : static_cast<int>(NO_ALARM);
+    int severity = invalid ? static_cast<int>(INVALID_ALARM) : static_cast<int>(NO_ALARM);
+    for (int id : data_params_) {
+        setParamAlarmStatus(id, status);
+        setParamAlarmSeverity(id, severity);
+    }
+    setIntegerParam(stallCountId_, static_cast<int>(stalls_.load()));
+    data_invalid_ = invalid;
+}
+
+asynStatus AttocubeIDS::write_read_json(std::string_view method, std::string_view params, std::string& reply,
+                                        std::string& error) {
+    json rpc = json::object();
+    rpc["jsonrpc"] = "2.0";
+    rpc["id"] = 1;
+    rpc["method"] = method;
+    if (!params.empty()) {
+        json parsed = json::parse(params.begin(), params.end(), nullptr, false);
+        if (parsed.is_discarded()) {
+            error = "params is not valid JSON";
+            return asynError;
+        }
+        rpc["params"] = std::move(parsed);
+    }
 
     // dump the json to a string, if its bigger than buffer size, return
     std::string rpc_str = rpc.dump();
     if (rpc_str.size() >= IO_BUFFER_SIZE) {
-        asynPrint(pasynUserDriver_, ASYN_TRACE_ERROR, "json out is larger that buffer size!\n");
-        return std::nullopt;
+        log_error(LogClass::Protocol, "json out is larger that buffer size!");
+        error = "request is larger than the I/O buffer";
+        return asynError;
     }
 
     // copy the json string to the output buffer
-    std::copy(rpc_str.begin(), rpc_str.end(), out_buffer_.begin());
+    auto io = shared_link().pool.acquire();
+    std::copy(rpc_str.begin(), rpc_str.end(), io->out.begin());
 
     // write the output buffer to the controller, return if there is an error
-    if (write_read(rpc_str.length()))
-        return std::nullopt;
+    RpcCodec::RpcError rpc_error = transport_error(write_read(*io, rpc_str.length()), *io);
+    if (rpc_error != RpcCodec::RpcError::None) {
+        count_rpc_error(rpc_error, RpcCodec::RemoteError{});
+        error = rpc_error == RpcCodec::RpcError::Timeout ? "no reply" : "incomplete reply";
+        return asynError;
+    }
 
-    try {
-        // parse the input JSON data and return it
-        return json::parse(in_buffer_.begin(), in_buffer_.begin() + nbytesin_);
-    } catch (...) {
-        asynPrint(pasynUserDriver_, ASYN_TRACE_ERROR, "Error parsing input JSON\n");
-        return std::nullopt;
+    // parse the input JSON data and hand it back as text
+    json parsed = json::parse(io->in.begin(), io->in.begin() + io->nbytesin, nullptr, false);
+    if (parsed.is_discarded() || !parsed.is_object()) {
+        log_error(LogClass::Protocol, "Error parsing input JSON");
+        count_rpc_error(RpcCodec::RpcError::Parse, RpcCodec::RemoteError{});
+        error = "reply is not valid JSON";
+        return asynError;
+    }
+    // a controller-side error is still a reply worth showing, but it is counted
+    if (parsed.contains("error")) {
+        RpcCodec::RemoteError remote;
+        const json& err = parsed["error"];
+        if (err.is_object() && err.contains("code") && err["code"].is_number_integer())
+            remote.code = err["code"].get<int64_t>();
+        if (err.is_object() && err.contains("message") && err["message"].is_string())
+            remote.message.raw = err["message"].get_ref<const std::string&>();
+        count_rpc_error(RpcCodec::RpcError::Remote, remote);
     }
+    reply = parsed.dump();
+    return asynSuccess;
+}
+
+int AttocubeIDS::create_quantity_param(const char* name, asynParamType type) {
+    int id;
+    createParam(name, type, &id);
+    if (quantity_of_param_.size() <= static_cast<size_t>(id))
+        quantity_of_param_.resize(id + 1, -1);
+    return id;
+}
+
+template <typename Interface, typename Callback>
+asynStatus AttocubeIDS::register_interrupt_hook(void* drvPvt, asynUser* pasynUser, Callback callback,
+                                                void* userPvt, void** registrarPvt) {
+    auto* pIDS = static_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(drvPvt));
+    const Interface* base = std::get<const Interface*>(pIDS->base_interfaces_);
+    asynStatus status = base->registerInterruptUser(drvPvt, pasynUser, callback, userPvt, registrarPvt);
+    if (status == asynSuccess)
+        pIDS->interest_.subscribe(pasynUser->reason, +1);
+    return status;
+}
+
+template <typename Interface>
+asynStatus AttocubeIDS::cancel_interrupt_hook(void* drvPvt, asynUser* pasynUser, void* registrarPvt) {
+    auto* pIDS = static_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(drvPvt));
+    const Interface* base = std::get<const Interface*>(pIDS->base_interfaces_);
+    asynStatus status = base->cancelInterruptUser(drvPvt, pasynUser, registrarPvt);
+    if (status == asynSuccess)
+        pIDS->interest_.subscribe(pasynUser->reason, -1);
+    return status;
+}
+
+template <typename Interface>
+void AttocubeIDS::hook_interface(asynInterface& iface, Interface& hooked, const Interface*& base) {
+    base = static_cast<const Interface*>(iface.pinterface);
+    hooked = *base;
+    hooked.registerInterruptUser = register_interrupt_hook<Interface>;
+    hooked.cancelInterruptUser = cancel_interrupt_hook<Interface>;
+    iface.pinterface = &hooked;
+}
+
+void AttocubeIDS::hook_interrupts() {
+    // asynManager keeps pointers to the asynInterface structs in asynStdInterfaces, so swapping
+    // pinterface here is seen by every device support that looks the port up after construction
+    hook_interface(asynStdInterfaces.int32, int32_hooked_, std::get<const asynInt32*>(base_interfaces_));
+    hook_interface(asynStdInterfaces.int64, int64_hooked_, std::get<const asynInt64*>(base_interfaces_));
+    hook_interface(asynStdInterfaces.float64, float64_hooked_, std::get<const asynFloat64*>(base_interfaces_));
+    hook_interface(asynStdInterfaces.octet, octet_hooked_, std::get<const asynOctet*>(base_interfaces_));
+    int32_hooked_.write = write_hook<asynInt32, epicsInt32>;
+    float64_hooked_.write = write_hook<asynFloat64, epicsFloat64>;
 }
 
-void AttocubeIDS::poll() {
-    while (true) {
-        // auto start = std::chrono::steady_clock::now();
+thread_local std::chrono::steady_clock::time_point AttocubeIDS::command_start_;
+thread_local AttocubeIDS* AttocubeIDS::cycle_owner_ = nullptr;
 
+template <typename Interface, typename T>
+asynStatus AttocubeIDS::write_hook(void* drvPvt, asynUser* pasynUser, T value) {
+    auto* pIDS = static_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(drvPvt));
+    const Interface* base = std::get<const Interface*>(pIDS->base_interfaces_);
+    command_start_ = std::chrono::steady_clock::now();
+    pIDS->commands_waiting_++;
+    asynStatus status = base->write(drvPvt, pasynUser, value);
+    pIDS->commands_waiting_--;
+    pIDS->command_done_.signal();
+    return status;
+}
+
+void AttocubeIDS::record_command_latency() {
+    // from the moment the write reached the driver, including any wait for the poller
+    double latency =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - command_start_).count();
+    command_latency_max_ = std::max(command_latency_max_, latency);
+    setDoubleParam(cmdLatencyId_, latency);
+}
+
+void AttocubeIDS::yield_to_commands() {
+    while (commands_waiting_.load() > 0 && !stopping_) {
+        unlock();
+        command_done_.wait(IO_TIMEOUT);
         lock();
+    }
+}
 
-        double poll_period;
-        getDoubleParam(pollPeriodId_, &poll_period);
-        poll_period = std::max(poll_period, POLL_PERIOD_MIN);
+asynStatus AttocubeIDS::drvUserCreate(asynUser* pasynUser, const char* drvInfo, const char** pptypeName,
+                                      size_t* psize) {
+    asynStatus status = asynPortDriver::drvUserCreate(pasynUser, drvInfo, pptypeName, psize);
+    if (status == asynSuccess)
+        interest_.bind(pasynUser->reason, +1);
+    return status;
+}
 
-        if (auto disps = do_rpc<I64Array4>(Method::AxesDisplacement); disps) {
-            auto [_, d0, d1, d2] = *disps;
-            setInteger64Param(axis0DisplacementId_, d0);
-            setInteger64Param(axis1DisplacementId_, d1);
-            setInteger64Param(axis2DisplacementId_, d2);
-        }
+asynStatus AttocubeIDS::drvUserDestroy(asynUser* pasynUser) {
+    interest_.bind(pasynUser->reason, -1);
+    return asynPortDriver::drvUserDestroy(pasynUser);
+}
 
-        if (auto abspos = do_rpc<I64Array4>(Method::AbsolutePositions); abspos) {
-            auto [_, p0, p1, p2] = *abspos;
-            setInteger64Param(axis0AbsolutePosId_, p0);
-            setInteger64Param(axis1AbsolutePosId_, p1);
-            setInteger64Param(axis2AbsolutePosId_, p2);
+void AttocubeIDS::report(FILE* fp, int details) {
+    fprintf(fp, "AttocubeIDS %s: poll RPCs sent %zu, skipped for lack of interest %zu\n", portName, rpcs_done_,
+            rpcs_skipped_);
+    fprintf(fp, "  runs on the shared executor, %zu workers, see AttocubeIDSExecutorReport\n", executor_.size());
+    fprintf(fp, "  longest command latency %.3f ms\n", command_latency_max_);
+    fprintf(fp, "  failed RPCs: timeout %u, transport %u, framing %u, parse %u, type %u, remote %u\n",
+            rpc_errors_[1].load(), rpc_errors_[2].load(), rpc_errors_[3].load(), rpc_errors_[4].load(),
+            rpc_errors_[5].load(), rpc_errors_[6].load());
+    for (size_t i = 0; i < links_.size(); i++) {
+        const Link& link = *links_[i];
+        fprintf(fp, "  connection %zu (%s) to %s%s\n", i,
+                links_.size() == 1 ? "all RPCs" : i == 0 ? "displacement" : "shared", link.port.c_str(),
+                transport_ == Transport::Native ? ", native" : "");
+        if (link.native)
+            fprintf(fp, "    %llu exchanges, %llu failed, %llu connects\n",
+                    static_cast<unsigned long long>(link.native->exchanges()),
+                    static_cast<unsigned long long>(link.native->failures()),
+                    static_cast<unsigned long long>(link.native->connects()));
+        fprintf(fp, "    I/O contexts %zu, at most %zu in use, %zu requests waited for one\n",
+                link.pool.size(), link.pool.peak_in_use(), link.pool.waits());
+    }
+    if (shm_)
+        fprintf(fp, "  shared memory %s, samples published %llu\n", shm_->name(),
+                static_cast<unsigned long long>(shm_->last_seq()));
+    if (initialized_)
+        fprintf(fp, "  initialised %.3f s after AttocubeIDSConfig, %u attempts\n", init_seconds_,
+                init_attempts_);
+    else
+        fprintf(fp, "  %s to %s, not initialised after %.1f s, %u attempts\n",
+                connected_ ? "connected" : "not connected", conn_port_.c_str(),
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - created_).count(),
+                init_attempts_);
+    if (poller_suspended_)
+        fprintf(fp, "  poller suspended\n");
+    fprintf(fp, "  last poll cycle %.3f s ago, %u stalls%s\n", heartbeat_age(), stalls_.load(),
+            stalled_ ? ", stalled now" : "");
+    if (mcast_)
+        fprintf(fp, "  multicast %s session %08x, %zu samples per packet, packets sent %llu, dropped %llu\n",
+                mcast_->destination().c_str(), mcast_->session(), mcast_->samples_per_packet(),
+                static_cast<unsigned long long>(mcast_->packets_sent()),
+                static_cast<unsigned long long>(mcast_->packets_dropped()));
+    if (details >= 1) {
+        for (size_t id = 0; id < interest_.size(); id++) {
+            const char* name = "";
+            getParamName(id, &name);
+            fprintf(fp, "  %-24s bound %d, subscribed %d, %s\n", name, interest_.bound(id),
+                    interest_.subscribed(id), interest_.active(id) ? "active" : "idle");
         }
+    }
+    asynPortDriver::report(fp, details);
+}
 
-        if (auto refpos = do_rpc<I64Array4>(Method::ReferencePositions); refpos) {
-            auto [_, r0, r1, r2] = *refpos;
-            setInteger64Param(axis0ReferencePosId_, r0);
-            setInteger64Param(axis1ReferencePosId_, r1);
-            setInteger64Param(axis2ReferencePosId_, r2);
-        }
+void AttocubeIDS::set_string_param(int id, const RpcCodec::JsonString& value, std::optional<std::string>& cache) {
+    if (cache && value.equals(*cache))
+        return;
+    if (!cache)
+        cache.emplace();
+    if (value.assign_to(*cache))
+        setStringParam(id, *cache);
+    else
+        cache.reset();
+}
 
-        if (auto meas_enabled = do_rpc<IntPair>(Method::MeasurementEnabled); meas_enabled) {
-            auto [_, enabled] = *meas_enabled;
-            setIntegerParam(measurementEnabledId_, enabled);
-        }
+void AttocubeIDS::fetch_quantities() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto& q : quantities_) {
+        if (q.policy == FetchPolicy::OnDemand)
+            continue;
+        if (q.policy == FetchPolicy::Periodic && now < q.next_fetch)
+            continue;
+
+        if (stopping_ || !initialized_)
+            break;
+        if ((q.axis >= 0 && !axis_enabled(axis_enable_, q.axis)) || !interest_.any_active(q.params))
+            continue;
+
+        q.next_fetch = now + q.period;
+        yield_to_commands();
+        q.fetch();
+    }
+}
+
+void AttocubeIDS::fetch_on_read(int param) {
+    interest_.touch(param);
+    if (param < 0 || static_cast<size_t>(param) >= quantity_of_param_.size() || quantity_of_param_[param] < 0)
+        return;
+    auto& q = quantities_[quantity_of_param_[param]];
+    if (q.policy == FetchPolicy::OnDemand)
+        q.fetch();
+}
+
+asynStatus AttocubeIDS::readInt32(asynUser* pasynUser, epicsInt32* value) {
+    fetch_on_read(pasynUser->reason);
+    return asynPortDriver::readInt32(pasynUser, value);
+}
+
+asynStatus AttocubeIDS::readInt64(asynUser* pasynUser, epicsInt64* value) {
+    fetch_on_read(pasynUser->reason);
+    return asynPortDriver::readInt64(pasynUser, value);
+}
+
+asynStatus AttocubeIDS::readFloat64(asynUser* pasynUser, epicsFloat64* value) {
+    fetch_on_read(pasynUser->reason);
+    return asynPortDriver::readFloat64(pasynUser, value);
+}
+
+asynStatus AttocubeIDS::set_derived(size_t slot, std::string_view expr, std::string& error) {
+    if (slot >= MAX_DERIVED) {
+        error = "slot out of range";
+        return asynError;
+    }
+
+    if (expr.empty()) {
+        derived_[slot].reset();
+    } else {
+        auto program = DerivedProgram::compile(expr, error);
+        if (!program)
+            return asynError;
+        derived_[slot] = std::move(program);
+    }
+    setStringParam(derivedExprId_[slot], std::string(expr));
+    return asynSuccess;
+}
+
+void AttocubeIDS::set_axis_enable(uint32_t mask) {
+    axis_enable_ = mask & ALL_AXES;
+    setIntegerParam(axisEnableId_, static_cast<int>(axis_enable_));
+
+    disp_params_.clear();
+    abs_params_.clear();
+    ref_params_.clear();
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        if (!axis_enabled(axis_enable_, axis))
+            continue;
+        for (int id : {axisDisplacementId_[axis], axisDisplacementEguId_[axis], axisVelocityId_[axis],
+                       axisAccelerationId_[axis], axisFilteredId_[axis]})
+            disp_params_.push_back(id);
+        abs_params_.push_back(axisAbsolutePosId_[axis]);
+        abs_params_.push_back(axisAbsolutePosEguId_[axis]);
+        ref_params_.push_back(axisReferencePosId_[axis]);
+    }
+}
+
+void AttocubeIDS::configure_estimators() {
+    int mode, window;
+    double alpha, beta, gamma;
+    getIntegerParam(estModeId_, &mode);
+    getIntegerParam(estWindowId_, &window);
+    getDoubleParam(estAlphaId_, &alpha);
+    getDoubleParam(estBetaId_, &beta);
+    getDoubleParam(estGammaId_, &gamma);
+    for (auto& estimator : estimators_) {
+        estimator.configure(static_cast<MotionEstimator<MAX_EST_WINDOW>::Mode>(mode), std::max(window, 1), alpha,
+                            beta, gamma);
+    }
+}
+
+asynStatus AttocubeIDS::set_filter(size_t axis, std::string_view spec, std::string& error) {
+    if (axis >= NUM_AXES) {
+        error = "axis out of range";
+        return asynError;
+    }
+
+    auto chain = FilterChain::parse(spec, error);
+    if (!chain)
+        return asynError;
+    filters_[axis] = *chain;
+    setStringParam(axisFilterId_[axis], std::string(spec));
+    return asynSuccess;
+}
+
+asynStatus AttocubeIDS::enable_shm(const char* name, size_t num_slots) {
+    std::unique_ptr<ShmWriter> writer(ShmWriter::create(name, num_slots));
+    if (!writer)
+        return asynError;
+    shm_ = std::move(writer);
+    return asynSuccess;
+}
+
+asynStatus AttocubeIDS::enable_mcast(const std::string& group, int port, int samples_per_packet, int ttl,
+                                     const std::string& iface, std::string& error) {
+    auto publisher = McastPublisher::create(group, port, samples_per_packet, ttl, iface, error);
+    if (!publisher)
+        return asynError;
+    mcast_ = std::move(publisher);
+    return asynSuccess;
+}
+
+bool AttocubeIDS::derived_wants(uint32_t mask) const {
+    for (size_t slot = 0; slot < MAX_DERIVED; slot++) {
+        if (derived_[slot] && (derived_[slot]->inputs_used() & mask) && interest_.active(derivedValueId_[slot]))
+            return true;
+    }
+    return false;
+}
+
+void AttocubeIDS::evaluate_derived(const DerivedInputs& inputs, uint32_t valid) {
+    for (size_t slot = 0; slot < MAX_DERIVED; slot++) {
+        const auto& program = derived_[slot];
+        if (!program || (program->inputs_used() & ~valid) || !interest_.active(derivedValueId_[slot]))
+            continue;
+        published_.add(derivedValueId_[slot], program->evaluate(inputs));
+    }
+}
 
-	if (auto mode = do_rpc<StringTuple>(Method::CurrentMode); mode) {
-	    setStringParam(currentModeId_, std::get<0>(*mode));
-	}
+void AttocubeIDS::flush_published() {
+    int mode;
+    getIntegerParam(publishModeId_, &mode);
+    if (static_cast<PublishMode>(mode) == PublishMode::Decimate)
+        setTimeStamp(&decimated_time_);
+    published_.take(static_cast<PublishMode>(mode), [this](int id, bool integer, double value) {
+        if (integer)
+            setInteger64Param(id, PublishAccumulator::to_integer(value));
+        else
+            setDoubleParam(id, value);
+    });
+}
 
+void AttocubeIDS::publish(uint64_t generation) {
+    lock();
+    // a rate change started a new chain or stop() is ending this one, it ends here
+    if (generation != publish_generation_ || stopping_) {
+        unlock();
+        return;
+    }
+    double publish_rate;
+    getDoubleParam(publishRateId_, &publish_rate);
+    if (publish_rate > 0.0) {
+        flush_published();
         callParamCallbacks();
+        auto next = std::chrono::steady_clock::now() + std::chrono::duration<double>(1.0 / publish_rate);
+        executor_.submit_at(std::chrono::time_point_cast<Executor::Clock::duration>(next),
+                            [this, generation] { publish(generation); });
+    }
+    unlock();
+}
+
+void AttocubeIDS::poll(uint64_t generation) {
+    // auto start = std::chrono::steady_clock::now();
+
+    lock();
+    // the watchdog started a new chain or stop() ended it, this one ends here
+    if (generation != poll_generation_ || stopping_) {
         unlock();
+        return;
+    }
+    cycle_active_ = true;
+    cycle_start_ns_ = steady_ns();
+    cycle_owner_ = this;
+
+    // the startup handshake: set up the transport and read what does not change at runtime,
+    // retried until it worked. Until then the cycle sends no RPCs, so an unreachable
+    // controller does not keep a worker busy with timeouts.
+    auto cycle_start = std::chrono::steady_clock::now();
+    if (!initialized_ && cycle_start >= next_connect_) {
+        next_connect_ = cycle_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                          std::chrono::duration<double>(CONNECT_RETRY_PERIOD));
+        init_attempts_++;
+        if ((connected_ || connect_transport()) && fetch_static_data())
+            mark_initialized();
+    }
+    const uint32_t link_errors = link_error_count();
+
+    double poll_period;
+    getDoubleParam(pollPeriodId_, &poll_period);
+    poll_period = std::max(poll_period, POLL_PERIOD_MIN);
+
+    std::array<double, NUM_AXES> egu;
+    DerivedInputs derived_inputs{};
+    uint32_t derived_valid = 0;
+    // disabled axes are neither converted nor published, and an RPC that only feeds them is skipped
+    const uint32_t axes = axis_enable_;
+    const uint32_t derived_disp_mask = axes << DERIVED_D0;
+    const uint32_t derived_abs_mask = axes << DERIVED_P0;
+    bool snapshot_wanted = snapshot_readers_.load(std::memory_order_relaxed) > 0;
+    idsSnapshot snapshot{};
+    snapshot.cycle = ++cycle_;
+
+    // with several native connections the status queries go out on the shared ones while this
+    // thread reads the displacement, otherwise they are sent from here after it as before
+    const bool abs_due = poll_due(abs_params_, axes && (snapshot_wanted || derived_wants(derived_abs_mask)));
+    const bool ref_due = poll_due(ref_params_);
+    const bool meas_due = poll_due(std::array{measurementEnabledId_});
+    auto* abs_rpc = start_rpc<Method::AbsolutePositions>(abs_due);
+    auto* ref_rpc = start_rpc<Method::ReferencePositions>(ref_due);
+    auto* meas_rpc = start_rpc<Method::MeasurementEnabled>(meas_due);
+
+    if (auto disps = poll_rpc<Method::AxesDisplacement>(
+            disp_params_, axes && (shm_ || mcast_ || snapshot_wanted || derived_wants(derived_disp_mask)));
+        disps) {
+        // everything published this cycle carries the time the displacement arrived
+        updateTimeStamp();
+        epicsTimeStamp disp_time;
+        getTimeStamp(&disp_time);
+        auto steady_now = std::chrono::steady_clock::now();
+        double sample_time = std::chrono::duration<double>(steady_now.time_since_epoch()).count();
+        int64_t realtime_ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        const std::array<int64_t, NUM_AXES> raw_disp = axis_values(*disps);
+        if (shm_) {
+            idsShmSample sample{};
+            sample.realtime_ns = realtime_ns;
+            sample.monotonic_ns =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(steady_now.time_since_epoch()).count();
+            sample.valid_mask = axes;
+            for (size_t axis = 0; axis < NUM_AXES; axis++)
+                sample.displacement_pm[axis] = raw_disp[axis];
+            shm_->publish(sample);
+        }
+        if (mcast_) {
+            std::array<int64_t, IDS_MCAST_AXES> pm{};
+            std::copy(raw_disp.begin(), raw_disp.end(), pm.begin());
+            mcast_->add(realtime_ns, axes, pm);
+        }
+        conversion_.apply(raw_disp, egu);
+        for (size_t axis = 0; axis < NUM_AXES; axis++) {
+            if (!axis_enabled(axes, axis))
+                continue;
+            published_.add(axisDisplacementId_[axis], raw_disp[axis]);
+            published_.add(axisDisplacementEguId_[axis], egu[axis]);
+            derived_inputs[DERIVED_D0 + axis] = egu[axis];
+            MotionEstimate motion = estimators_[axis].update(sample_time, egu[axis]);
+            published_.add(axisVelocityId_[axis], motion.velocity);
+            published_.add(axisAccelerationId_[axis], motion.acceleration);
+            published_.add(axisFilteredId_[axis], filters_[axis].process(egu[axis]));
 
-        // auto end = std::chrono::steady_clock::now();
-        // auto elap = std::chrono::duration<double>(end-start);
-        // std::cout << "elap = " << elap.count()*1000 << " ms" << std::endl;
-        if (poller_should_suspend_) {
-            poller_should_suspend_ = false;
-            epicsThreadSuspendSelf();
+            idsSnapshotAxis& snap = snapshot.axis[axis];
+            snap.displacement_pm = raw_disp[axis];
+            snap.displacement = egu[axis];
+            snap.velocity = motion.velocity;
+            snap.displacement_time = disp_time;
+            snapshot.valid_mask |= IDS_SNAPSHOT_DISP(axis);
         }
+        derived_valid |= derived_disp_mask;
+    }
+
+    if (auto abspos = finish_rpc(abs_rpc, abs_due); abspos) {
+        const std::array<int64_t, NUM_AXES> raw_abs = axis_values(*abspos);
+        epicsTimeStamp abs_time;
+        epicsTimeGetCurrent(&abs_time);
+        conversion_.apply(raw_abs, egu);
+        for (size_t axis = 0; axis < NUM_AXES; axis++) {
+            if (!axis_enabled(axes, axis))
+                continue;
+            published_.add(axisAbsolutePosId_[axis], raw_abs[axis]);
+            published_.add(axisAbsolutePosEguId_[axis], egu[axis]);
+            derived_inputs[DERIVED_P0 + axis] = egu[axis];
+
+            idsSnapshotAxis& snap = snapshot.axis[axis];
+            snap.absolute_pm = raw_abs[axis];
+            snap.absolute = egu[axis];
+            snap.absolute_time = abs_time;
+            snapshot.valid_mask |= IDS_SNAPSHOT_ABS(axis);
+        }
+        derived_valid |= derived_abs_mask;
+    }
+
+    evaluate_derived(derived_inputs, derived_valid);
+    snapshot_.store(snapshot);
+
+    if (auto refpos = finish_rpc(ref_rpc, ref_due); refpos) {
+        const std::array<int64_t, NUM_AXES> raw_ref = axis_values(*refpos);
+        for (size_t axis = 0; axis < NUM_AXES; axis++) {
+            if (axis_enabled(axes, axis))
+                published_.add(axisReferencePosId_[axis], raw_ref[axis]);
+        }
+    }
+
+    if (auto meas_enabled = finish_rpc(meas_rpc, meas_due); meas_enabled) {
+        auto [_, enabled] = *meas_enabled;
+        setIntegerParam(measurementEnabledId_, enabled);
+    }
+
+    if (poll_due(std::array{currentModeId_})) {
+        visit_rpc<Method::CurrentMode>(
+            [this](const auto& mode) { set_string_param(currentModeId_, std::get<0>(mode), current_mode_); });
+    }
+
+    fetch_quantities();
+    publish_rpc_errors();
+
+    // the heartbeat the watchdog checks: a cycle that reached the controller, so one spent
+    // in timeouts does not count. HEARTBEAT_AGE shows how long it took to come round.
+    stall_timeout_ = std::max(WATCHDOG_STALL_MIN, WATCHDOG_STALL_CYCLES * poll_period);
+    if (initialized_ && link_error_count() == link_errors) {
+        int64_t beat = steady_ns();
+        setDoubleParam(heartbeatAgeId_, (beat - heartbeat_ns_.exchange(beat)) * 1e-9);
+        if (data_invalid_)
+            set_data_invalid(false);
+        if (stalled_.exchange(false))
+            Logger::shared().log(LogClass::Internal, portName, "poll cycles are back");
+    }
+
+    // without a publish rate every cycle is published as before, otherwise publish() calls
+    // the callbacks
+    double publish_rate;
+    getDoubleParam(publishRateId_, &publish_rate);
+    published_.set_decimation(publish_rate > 0.0 ? std::lround(1.0 / (publish_rate * poll_period)) : 1);
+    if (published_.end_cycle())
+        getTimeStamp(&decimated_time_);
+    if (publish_rate <= 0.0) {
+        flush_published();
+        callParamCallbacks();
+    }
 
-        epicsThreadSleep(poll_period);
+    // auto end = std::chrono::steady_clock::now();
+    // auto elap = std::chrono::duration<double>(end-start);
+    // std::cout << "elap = " << elap.count()*1000 << " ms" << std::endl;
+    if (poller_should_suspend_) {
+        poller_should_suspend_ = false;
+        poller_suspended_ = true;
+        watching_ = false;
+    } else if (!stopping_) {
+        auto next = std::chrono::steady_clock::now() + std::chrono::duration<double>(poll_period);
+        executor_.submit_at(std::chrono::time_point_cast<Executor::Clock::duration>(next),
+                            [this, generation] { poll(generation); });
     }
+    cycle_active_ = false;
+    cycle_owner_ = nullptr;
+    // stop() gave up waiting for this cycle, the rest of the stop is done here
+    if (stop_late_.exchange(false))
+        finish_stop();
+    cycle_done_.signal();
+    unlock();
 }
 
 asynStatus AttocubeIDS::writeInt32(asynUser* pasynUser, epicsInt32 value) {
@@ -164,50 +1020,483 @@ asynStatus AttocubeIDS::writeInt32(asynUser* pasynUser, epicsInt32 value) {
     bool comm_ok = true;
 
     if (function == resumePollerId_) {
-        epicsThreadResume(poller_thread_id_);
+        poller_should_suspend_ = false;
+        if (poller_suspended_ && acquiring_) {
+            poller_suspended_ = false;
+            heartbeat_ns_ = steady_ns();
+            watching_ = true;
+            executor_.submit([this, generation = poll_generation_] { poll(generation); });
+        }
     } else if (function == suspendPollerId_) {
         poller_should_suspend_ = true;
     }
 
-    else if (function == startMeasurementId_) {
-	if (auto err = do_rpc<IntTuple>(Method::StartMeasurement); err) {
-	    auto [err_no] = *err;
-	    std::cout << "Starting measurement. err_no = " << err_no << std::endl;
-	}
-    } else if (function == stopMeasurementId_) {
-	if (auto err = do_rpc<IntTuple>(Method::StopMeasurement); err) {
-	    auto [err_no] = *err;
-	    std::cout << "Stopping measurement. err_no = " << err_no << std::endl;
-	}
+    else if (function == startMeasurementId_ || function == stopMeasurementId_) {
+        auto err = function == startMeasurementId_ ? do_rpc<Method::StartMeasurement>()
+                                                   : do_rpc<Method::StopMeasurement>();
+        if (err) {
+            auto [err_no] = *err;
+            setIntegerParam(cmdErrNoId_, err_no);
+            comm_ok = err_no == 0;
+        } else {
+            comm_ok = false;
+        }
+    } else if (function == axisEnableId_) {
+        const uint32_t was_enabled = axis_enable_;
+        set_axis_enable(static_cast<uint32_t>(value));
+        // re-enabled axes must not difference against or filter positions from before they
+        // were disabled
+        configure_estimators();
+        for (size_t axis = 0; axis < NUM_AXES; axis++) {
+            if (axis_enabled(axis_enable_, axis) && !axis_enabled(was_enabled, axis))
+                filters_[axis].reset();
+        }
+    } else if (function == publishModeId_) {
+        setIntegerParam(function, value);
+        published_.reset();
+    } else if (function == estModeId_ || function == estWindowId_) {
+        setIntegerParam(function, value);
+        configure_estimators();
     }
 
-
+    record_command_latency();
     callParamCallbacks();
     return comm_ok ? asynSuccess : asynError;
 }
 
-// asynStatus AttocubeIDS::writeFloat64(asynUser* pasynUser, epicsFloat64 value) {
-// // int function = pasynUser->reason;
-// bool comm_ok = true;
-//
-// callParamCallbacks();
-// return comm_ok ? asynSuccess : asynError;
-// }
+asynStatus AttocubeIDS::writeFloat64(asynUser* pasynUser, epicsFloat64 value) {
+    int function = pasynUser->reason;
+
+    // conversion coefficients take effect from the next poll cycle on
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        if (function == axisScaleId_[axis]) {
+            conversion_.scale[axis] = value;
+        } else if (function == axisOffsetId_[axis]) {
+            conversion_.offset[axis] = value;
+        } else if (function == axisPoly2Id_[axis]) {
+            conversion_.poly2[axis] = value;
+        } else if (function == axisPoly3Id_[axis]) {
+            conversion_.poly3[axis] = value;
+        }
+    }
+
+    asynStatus status = asynPortDriver::writeFloat64(pasynUser, value);
+    if (function == estAlphaId_ || function == estBetaId_ || function == estGammaId_)
+        configure_estimators();
+    else if (function == publishRateId_ && acquiring_ && !stopping_)
+        // a new chain at the new rate, while stopped start() begins one
+        executor_.submit([this, generation = ++publish_generation_] { publish(generation); });
+    record_command_latency();
+    callParamCallbacks();
+    return status;
+}
+
+asynStatus AttocubeIDS::writeOctet(asynUser* pasynUser, const char* value, size_t maxChars, size_t* nActual) {
+    int function = pasynUser->reason;
+
+    for (size_t axis = 0; axis < NUM_AXES; axis++) {
+        if (function == axisFilterId_[axis]) {
+            std::string error;
+            *nActual = maxChars;
+            if (set_filter(axis, std::string_view(value, strnlen(value, maxChars)), error)) {
+                epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize, "%s", error.c_str());
+                return asynError;
+            }
+            callParamCallbacks();
+            return asynSuccess;
+        }
+    }
+
+    for (size_t slot = 0; slot < MAX_DERIVED; slot++) {
+        if (function == derivedExprId_[slot]) {
+            std::string error;
+            *nActual = maxChars;
+            if (set_derived(slot, std::string_view(value, strnlen(value, maxChars)), error)) {
+                epicsSnprintf(pasynUser->errorMessage, pasynUser->errorMessageSize, "%s", error.c_str());
+                return asynError;
+            }
+            callParamCallbacks();
+            return asynSuccess;
+        }
+    }
+
+    return asynPortDriver::writeOctet(pasynUser, value, maxChars, nActual);
+}
 
 // register function for iocsh
-extern "C" int AttocubeIDSConfig(const char* conn_port, const char* driver_port) {
-    new AttocubeIDS(conn_port, driver_port);
+// transport is "asyn" (default, conn_port is an asyn IP port) or "native" (conn_port is host:port), e.g.
+// AttocubeIDSConfig("192.168.1.1:9090", "IDS1", "native")
+// For several connections to the controller, conn_port lists one asyn IP port per connection or
+// connections gives the number of native sockets, e.g.
+// AttocubeIDSConfig("IDS1_IP0,IDS1_IP1", "IDS1")
+// AttocubeIDSConfig("192.168.1.1:9090", "IDS1", "native", 2)
+extern "C" int AttocubeIDSConfig(const char* conn_port, const char* driver_port, const char* transport,
+                                 int connections) {
+    Transport selected = Transport::Asyn;
+    if (transport && *transport) {
+        if (strcmp(transport, "native") == 0) {
+            selected = Transport::Native;
+        } else if (strcmp(transport, "asyn") != 0) {
+            printf("AttocubeIDSConfig: transport must be asyn or native\n");
+            return asynError;
+        }
+    }
+    std::string ports = conn_port ? conn_port : "";
+    size_t listed = std::count(ports.begin(), ports.end(), ',') + 1;
+    if (selected == Transport::Asyn) {
+        if (connections > 1) {
+            printf("AttocubeIDSConfig: the asyn transport opens one connection per asyn IP port listed\n");
+            return asynError;
+        }
+        connections = static_cast<int>(listed);
+        if (ports.empty() || ports.front() == ',' || ports.back() == ',' ||
+            ports.find(",,") != std::string::npos) {
+            printf("AttocubeIDSConfig: empty asyn port name in \"%s\"\n", ports.c_str());
+            return asynError;
+        }
+    } else if (listed > 1) {
+        printf("AttocubeIDSConfig: the native transport takes one host:port\n");
+        return asynError;
+    }
+    connections = std::max(connections, 1);
+    if (static_cast<size_t>(connections) > MAX_CONNECTIONS) {
+        printf("AttocubeIDSConfig: at most %zu connections\n", MAX_CONNECTIONS);
+        return asynError;
+    }
+    new AttocubeIDS(conn_port, driver_port, selected, connections);
     return (asynSuccess);
 }
 
-static const iocshArg AttocubeIDSArg0 = {"Connection asyn port", iocshArgString};
+// Untyped JSON-RPC call for methods not in the Method registry, e.g.
+// AttocubeIDSCall("IDS1", "com.attocube.ids.ecu.getEnabled", "")
+extern "C" int AttocubeIDSCall(const char* driver_port, const char* method, const char* params_str) {
+    AttocubeIDS* pIDS = dynamic_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(findAsynPortDriver(driver_port)));
+    if (!pIDS || !method) {
+        printf("AttocubeIDSCall: usage AttocubeIDSCall(port, method, [params JSON array])\n");
+        return asynError;
+    }
+
+    std::string reply, error;
+    pIDS->lock();
+    asynStatus status = pIDS->write_read_json(method, params_str ? params_str : "", reply, error);
+    pIDS->unlock();
+    if (status) {
+        printf("AttocubeIDSCall: %s\n", error.c_str());
+        return status;
+    }
+    printf("%s\n", reply.c_str());
+    return asynSuccess;
+}
+
+// Compiles an expression into a derived quantity slot, e.g.
+// AttocubeIDSDerived("IDS1", 0, "atan((d0 - d1) / 25000)")
+extern "C" int AttocubeIDSDerived(const char* driver_port, int slot, const char* expr) {
+    AttocubeIDS* pIDS = dynamic_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(findAsynPortDriver(driver_port)));
+    if (!pIDS || slot < 0) {
+        printf("AttocubeIDSDerived: usage AttocubeIDSDerived(port, slot, expression)\n");
+        return asynError;
+    }
+
+    std::string error;
+    pIDS->lock();
+    asynStatus status = pIDS->set_derived(slot, expr ? expr : "", error);
+    pIDS->callParamCallbacks();
+    pIDS->unlock();
+    if (status)
+        printf("AttocubeIDSDerived: %s\n", error.c_str());
+    return status;
+}
+
+// Sets the filter chain of an axis, e.g.
+// AttocubeIDSFilter("IDS1", 0, "lowpass 20 0.707 100; notch 12.5 5 100")
+extern "C" int AttocubeIDSFilter(const char* driver_port, int axis, const char* spec) {
+    AttocubeIDS* pIDS = dynamic_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(findAsynPortDriver(driver_port)));
+    if (!pIDS || axis < 0) {
+        printf("AttocubeIDSFilter: usage AttocubeIDSFilter(port, axis, spec)\n");
+        return asynError;
+    }
+
+    std::string error;
+    pIDS->lock();
+    asynStatus status = pIDS->set_filter(axis, spec ? spec : "", error);
+    pIDS->callParamCallbacks();
+    pIDS->unlock();
+    if (status)
+        printf("AttocubeIDSFilter: %s\n", error.c_str());
+    return status;
+}
+
+// Waits until every port finished its startup handshake or timeout seconds passed, so the
+// handshakes of all controllers overlap; meant to come just before iocInit, e.g.
+// AttocubeIDSWaitInit(10)
+extern "C" int AttocubeIDSWaitInit(double timeout) {
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                std::chrono::duration<double>(std::max(timeout, 0.0)));
+    auto is_ready = [](AttocubeIDS* ids) { return ids->initialized(); };
+    std::unique_lock<std::mutex> guard(init_mutex);
+    init_changed.wait_until(guard, deadline,
+                            [&] { return std::all_of(instances.begin(), instances.end(), is_ready); });
+
+    size_t ready = std::count_if(instances.begin(), instances.end(), is_ready);
+    printf("AttocubeIDSWaitInit: %zu of %zu controllers ready after %.2f s\n", ready, instances.size(),
+           std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    for (AttocubeIDS* ids : instances) {
+        if (!ids->initialized())
+            printf("  %s not ready, it keeps trying in the background\n", ids->portName);
+    }
+    return ready == instances.size() ? asynSuccess : asynTimeout;
+}
+
+// Stops the poll cycles of a port, waiting up to timeout seconds for a running one, e.g.
+// AttocubeIDSStop("IDS1", 2)
+extern "C" int AttocubeIDSStop(const char* driver_port, double timeout) {
+    AttocubeIDS* pIDS = dynamic_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(findAsynPortDriver(driver_port)));
+    if (!pIDS) {
+        printf("AttocubeIDSStop: usage AttocubeIDSStop(port, timeout)\n");
+        return asynError;
+    }
+    if (!pIDS->stop(timeout > 0.0 ? timeout : SHUTDOWN_TIMEOUT)) {
+        printf("AttocubeIDSStop: the poll cycle of %s did not stop in time\n", driver_port);
+        return asynTimeout;
+    }
+    return asynSuccess;
+}
+
+extern "C" int AttocubeIDSStart(const char* driver_port) {
+    AttocubeIDS* pIDS = dynamic_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(findAsynPortDriver(driver_port)));
+    if (!pIDS) {
+        printf("AttocubeIDSStart: usage AttocubeIDSStart(port)\n");
+        return asynError;
+    }
+    if (!pIDS->start()) {
+        printf("AttocubeIDSStart: %s is still stopping, try again once its poll cycle ended\n", driver_port);
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+extern "C" idsSnapshotSource* idsSnapshotFind(const char* port) {
+    AttocubeIDS* pIDS = dynamic_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(findAsynPortDriver(port)));
+    if (!pIDS)
+        return nullptr;
+    pIDS->add_snapshot_reader();
+    return reinterpret_cast<idsSnapshotSource*>(pIDS);
+}
+
+extern "C" int idsSnapshotRead(const idsSnapshotSource* source, idsSnapshot* snapshot) {
+    const auto* pIDS = reinterpret_cast<const AttocubeIDS*>(source);
+    return pIDS && pIDS->read_snapshot(*snapshot) ? 0 : -1;
+}
+
+// Publishes displacement samples to a shared-memory ring for consumers on the same host, e.g.
+// AttocubeIDSShm("IDS1", "/ids1", 1024)
+extern "C" int AttocubeIDSShm(const char* driver_port, const char* name, int num_slots) {
+    AttocubeIDS* pIDS = dynamic_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(findAsynPortDriver(driver_port)));
+    if (!pIDS || !name || name[0] != '/' || num_slots <= 0) {
+        printf("AttocubeIDSShm: usage AttocubeIDSShm(port, /name, slots)\n");
+        return asynError;
+    }
+
+    pIDS->lock();
+    asynStatus status = pIDS->enable_shm(name, num_slots);
+    pIDS->unlock();
+    if (status)
+        printf("AttocubeIDSShm: could not create shared memory %s: %s\n", name, strerror(errno));
+    return status;
+}
+
+// Sends displacement samples to a UDP multicast group, batched samples_per_packet to a datagram, e.g.
+// AttocubeIDSMcast("IDS1", "239.255.10.1", 5010, 10, 1, "")
+extern "C" int AttocubeIDSMcast(const char* driver_port, const char* group, int port, int samples_per_packet,
+                                int ttl, const char* iface) {
+    AttocubeIDS* pIDS = dynamic_cast<AttocubeIDS*>(static_cast<asynPortDriver*>(findAsynPortDriver(driver_port)));
+    if (!pIDS || !group) {
+        printf("AttocubeIDSMcast: usage AttocubeIDSMcast(port, group, udp port, samples per packet, ttl, "
+               "interface)\n");
+        return asynError;
+    }
+
+    std::string error;
+    pIDS->lock();
+    asynStatus status = pIDS->enable_mcast(group, port, samples_per_packet, ttl, iface ? iface : "", error);
+    pIDS->unlock();
+    if (status)
+        printf("AttocubeIDSMcast: %s\n", error.c_str());
+    return status;
+}
+
+// Sets up the worker threads shared by all ports, must come before the first AttocubeIDSConfig, e.g.
+// AttocubeIDSExecutor(4, "2,3")
+extern "C" int AttocubeIDSExecutor(int threads, const char* cpus_str) {
+    std::vector<int> cpus;
+    for (const char* p = cpus_str; p && *p;) {
+        char* end;
+        long cpu = strtol(p, &end, 10);
+        if (end == p || (*end && *end != ',')) {
+            printf("AttocubeIDSExecutor: usage AttocubeIDSExecutor(threads, [comma separated CPUs])\n");
+            return asynError;
+        }
+        cpus.push_back(static_cast<int>(cpu));
+        p = *end ? end + 1 : end;
+    }
+
+    std::string error;
+    if (threads <= 0 || !Executor::configure(threads, cpus, error)) {
+        printf("AttocubeIDSExecutor: %s\n", threads <= 0 ? "at least one thread is needed" : error.c_str());
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+extern "C" int AttocubeIDSExecutorReport() {
+    Executor::shared().report(stdout);
+    return asynSuccess;
+}
+
+// Limits the error messages of each class to rate per second with bursts of up to burst
+// messages, rate 0 prints every message, e.g. AttocubeIDSLogLimit(1, 5)
+extern "C" int AttocubeIDSLogLimit(double rate, double burst) {
+    if (rate < 0.0 || burst < 0.0) {
+        printf("AttocubeIDSLogLimit: usage AttocubeIDSLogLimit(messages per second, burst)\n");
+        return asynError;
+    }
+    Logger::shared().set_limit(rate, burst);
+    return asynSuccess;
+}
+
+extern "C" int AttocubeIDSLogReport() {
+    Logger::shared().report(stdout);
+    return asynSuccess;
+}
+
+static const iocshArg AttocubeIDSArg0 = {"Connection asyn port(s) or host:port", iocshArgString};
 static const iocshArg AttocubeIDSArg1 = {"Driver asyn port", iocshArgString};
-static const iocshArg* const AttocubeIDSArgs[2] = {&AttocubeIDSArg0, &AttocubeIDSArg1};
-static const iocshFuncDef AttocubeIDSFuncDef = {"AttocubeIDSConfig", 2, AttocubeIDSArgs};
+static const iocshArg AttocubeIDSArg2 = {"Transport (asyn or native)", iocshArgString};
+static const iocshArg AttocubeIDSArg3 = {"Native connections", iocshArgInt};
+static const iocshArg* const AttocubeIDSArgs[4] = {&AttocubeIDSArg0, &AttocubeIDSArg1, &AttocubeIDSArg2,
+                                                   &AttocubeIDSArg3};
+static const iocshFuncDef AttocubeIDSFuncDef = {"AttocubeIDSConfig", 4, AttocubeIDSArgs};
+
+static void AttocubeIDSCallFunc(const iocshArgBuf* args) {
+    AttocubeIDSConfig(args[0].sval, args[1].sval, args[2].sval, args[3].ival);
+}
+
+static const iocshArg AttocubeIDSCallArg0 = {"Driver asyn port", iocshArgString};
+static const iocshArg AttocubeIDSCallArg1 = {"Method", iocshArgString};
+static const iocshArg AttocubeIDSCallArg2 = {"Params (JSON array)", iocshArgString};
+static const iocshArg* const AttocubeIDSCallArgs[3] = {&AttocubeIDSCallArg0, &AttocubeIDSCallArg1,
+                                                       &AttocubeIDSCallArg2};
+static const iocshFuncDef AttocubeIDSCallFuncDef = {"AttocubeIDSCall", 3, AttocubeIDSCallArgs};
+
+static void AttocubeIDSCallCallFunc(const iocshArgBuf* args) {
+    AttocubeIDSCall(args[0].sval, args[1].sval, args[2].sval);
+}
+
+static const iocshArg AttocubeIDSDerivedArg0 = {"Driver asyn port", iocshArgString};
+static const iocshArg AttocubeIDSDerivedArg1 = {"Slot", iocshArgInt};
+static const iocshArg AttocubeIDSDerivedArg2 = {"Expression", iocshArgString};
+static const iocshArg* const AttocubeIDSDerivedArgs[3] = {&AttocubeIDSDerivedArg0, &AttocubeIDSDerivedArg1,
+                                                          &AttocubeIDSDerivedArg2};
+static const iocshFuncDef AttocubeIDSDerivedFuncDef = {"AttocubeIDSDerived", 3, AttocubeIDSDerivedArgs};
+
+static void AttocubeIDSDerivedCallFunc(const iocshArgBuf* args) {
+    AttocubeIDSDerived(args[0].sval, args[1].ival, args[2].sval);
+}
+
+static const iocshArg AttocubeIDSFilterArg0 = {"Driver asyn port", iocshArgString};
+static const iocshArg AttocubeIDSFilterArg1 = {"Axis", iocshArgInt};
+static const iocshArg AttocubeIDSFilterArg2 = {"Filter spec", iocshArgString};
+static const iocshArg* const AttocubeIDSFilterArgs[3] = {&AttocubeIDSFilterArg0, &AttocubeIDSFilterArg1,
+                                                         &AttocubeIDSFilterArg2};
+static const iocshFuncDef AttocubeIDSFilterFuncDef = {"AttocubeIDSFilter", 3, AttocubeIDSFilterArgs};
+
+static void AttocubeIDSFilterCallFunc(const iocshArgBuf* args) {
+    AttocubeIDSFilter(args[0].sval, args[1].ival, args[2].sval);
+}
+
+static const iocshArg AttocubeIDSShmArg0 = {"Driver asyn port", iocshArgString};
+static const iocshArg AttocubeIDSShmArg1 = {"Shared memory name", iocshArgString};
+static const iocshArg AttocubeIDSShmArg2 = {"Slots", iocshArgInt};
+static const iocshArg* const AttocubeIDSShmArgs[3] = {&AttocubeIDSShmArg0, &AttocubeIDSShmArg1,
+                                                      &AttocubeIDSShmArg2};
+static const iocshFuncDef AttocubeIDSShmFuncDef = {"AttocubeIDSShm", 3, AttocubeIDSShmArgs};
 
-static void AttocubeIDSCallFunc(const iocshArgBuf* args) { AttocubeIDSConfig(args[0].sval, args[1].sval); }
+static void AttocubeIDSShmCallFunc(const iocshArgBuf* args) {
+    AttocubeIDSShm(args[0].sval, args[1].sval, args[2].ival);
+}
+
+static const iocshArg AttocubeIDSMcastArg0 = {"Driver asyn port", iocshArgString};
+static const iocshArg AttocubeIDSMcastArg1 = {"Multicast group", iocshArgString};
+static const iocshArg AttocubeIDSMcastArg2 = {"UDP port", iocshArgInt};
+static const iocshArg AttocubeIDSMcastArg3 = {"Samples per packet", iocshArgInt};
+static const iocshArg AttocubeIDSMcastArg4 = {"TTL", iocshArgInt};
+static const iocshArg AttocubeIDSMcastArg5 = {"Interface address", iocshArgString};
+static const iocshArg* const AttocubeIDSMcastArgs[6] = {&AttocubeIDSMcastArg0, &AttocubeIDSMcastArg1,
+                                                        &AttocubeIDSMcastArg2, &AttocubeIDSMcastArg3,
+                                                        &AttocubeIDSMcastArg4, &AttocubeIDSMcastArg5};
+static const iocshFuncDef AttocubeIDSMcastFuncDef = {"AttocubeIDSMcast", 6, AttocubeIDSMcastArgs};
+
+static void AttocubeIDSMcastCallFunc(const iocshArgBuf* args) {
+    AttocubeIDSMcast(args[0].sval, args[1].sval, args[2].ival, args[3].ival, args[4].ival, args[5].sval);
+}
+
+static const iocshArg AttocubeIDSWaitInitArg0 = {"Timeout", iocshArgDouble};
+static const iocshArg* const AttocubeIDSWaitInitArgs[1] = {&AttocubeIDSWaitInitArg0};
+static const iocshFuncDef AttocubeIDSWaitInitFuncDef = {"AttocubeIDSWaitInit", 1, AttocubeIDSWaitInitArgs};
+
+static void AttocubeIDSWaitInitCallFunc(const iocshArgBuf* args) { AttocubeIDSWaitInit(args[0].dval); }
+
+static const iocshArg AttocubeIDSStopArg0 = {"Driver asyn port", iocshArgString};
+static const iocshArg AttocubeIDSStopArg1 = {"Timeout", iocshArgDouble};
+static const iocshArg* const AttocubeIDSStopArgs[2] = {&AttocubeIDSStopArg0, &AttocubeIDSStopArg1};
+static const iocshFuncDef AttocubeIDSStopFuncDef = {"AttocubeIDSStop", 2, AttocubeIDSStopArgs};
+
+static void AttocubeIDSStopCallFunc(const iocshArgBuf* args) { AttocubeIDSStop(args[0].sval, args[1].dval); }
+
+static const iocshArg AttocubeIDSStartArg0 = {"Driver asyn port", iocshArgString};
+static const iocshArg* const AttocubeIDSStartArgs[1] = {&AttocubeIDSStartArg0};
+static const iocshFuncDef AttocubeIDSStartFuncDef = {"AttocubeIDSStart", 1, AttocubeIDSStartArgs};
+
+static void AttocubeIDSStartCallFunc(const iocshArgBuf* args) { AttocubeIDSStart(args[0].sval); }
 
-void AttocubeIDSRegister(void) { iocshRegister(&AttocubeIDSFuncDef, AttocubeIDSCallFunc); }
+static const iocshArg AttocubeIDSExecutorArg0 = {"Threads", iocshArgInt};
+static const iocshArg AttocubeIDSExecutorArg1 = {"CPUs", iocshArgString};
+static const iocshArg* const AttocubeIDSExecutorArgs[2] = {&AttocubeIDSExecutorArg0, &AttocubeIDSExecutorArg1};
+static const iocshFuncDef AttocubeIDSExecutorFuncDef = {"AttocubeIDSExecutor", 2, AttocubeIDSExecutorArgs};
+
+static void AttocubeIDSExecutorCallFunc(const iocshArgBuf* args) { AttocubeIDSExecutor(args[0].ival, args[1].sval); }
+
+static const iocshFuncDef AttocubeIDSExecutorReportFuncDef = {"AttocubeIDSExecutorReport", 0, nullptr};
+
+static void AttocubeIDSExecutorReportCallFunc(const iocshArgBuf*) { AttocubeIDSExecutorReport(); }
+
+static const iocshArg AttocubeIDSLogLimitArg0 = {"Messages per second", iocshArgDouble};
+static const iocshArg AttocubeIDSLogLimitArg1 = {"Burst", iocshArgDouble};
+static const iocshArg* const AttocubeIDSLogLimitArgs[2] = {&AttocubeIDSLogLimitArg0, &AttocubeIDSLogLimitArg1};
+static const iocshFuncDef AttocubeIDSLogLimitFuncDef = {"AttocubeIDSLogLimit", 2, AttocubeIDSLogLimitArgs};
+
+static void AttocubeIDSLogLimitCallFunc(const iocshArgBuf* args) { AttocubeIDSLogLimit(args[0].dval, args[1].dval); }
+
+static const iocshFuncDef AttocubeIDSLogReportFuncDef = {"AttocubeIDSLogReport", 0, nullptr};
+
+static void AttocubeIDSLogReportCallFunc(const iocshArgBuf*) { AttocubeIDSLogReport(); }
+
+void AttocubeIDSRegister(void) {
+    iocshRegister(&AttocubeIDSFuncDef, AttocubeIDSCallFunc);
+    iocshRegister(&AttocubeIDSCallFuncDef, AttocubeIDSCallCallFunc);
+    iocshRegister(&AttocubeIDSDerivedFuncDef, AttocubeIDSDerivedCallFunc);
+    iocshRegister(&AttocubeIDSFilterFuncDef, AttocubeIDSFilterCallFunc);
+    iocshRegister(&AttocubeIDSShmFuncDef, AttocubeIDSShmCallFunc);
+    iocshRegister(&AttocubeIDSMcastFuncDef, AttocubeIDSMcastCallFunc);
+    iocshRegister(&AttocubeIDSWaitInitFuncDef, AttocubeIDSWaitInitCallFunc);
+    iocshRegister(&AttocubeIDSStopFuncDef, AttocubeIDSStopCallFunc);
+    iocshRegister(&AttocubeIDSStartFuncDef, AttocubeIDSStartCallFunc);
+    iocshRegister(&AttocubeIDSExecutorFuncDef, AttocubeIDSExecutorCallFunc);
+    iocshRegister(&AttocubeIDSExecutorReportFuncDef, AttocubeIDSExecutorReportCallFunc);
+    iocshRegister(&AttocubeIDSLogLimitFuncDef, AttocubeIDSLogLimitCallFunc);
+    iocshRegister(&AttocubeIDSLogReportFuncDef, AttocubeIDSLogReportCallFunc);
+}
 
 extern "C" {
 epicsExportRegistrar(AttocubeIDSRegister);
@@ -1,36 +1,51 @@
 #pragma once
 #include "json.hpp"
 #include <array>
+#include <asynFloat64.h>
+#include <asynInt32.h>
+#include <asynInt64.h>
+#include <asynOctet.h>
 #include <asynPortDriver.h>
+#include <epicsEvent.h>
+#include <epicsTimer.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <functional>
 #include <iostream>
 #include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
-using json = nlohmann::json;
+#include "attocubeIDSAxes.hpp"
+#include "attocubeIDSConversion.hpp"
+#include "attocubeIDSDerived.hpp"
+#include "attocubeIDSEstimator.hpp"
+#include "attocubeIDSExecutor.hpp"
+#include "attocubeIDSFilter.hpp"
+#include "attocubeIDSIo.hpp"
+#include "attocubeIDSLog.hpp"
+#include "attocubeIDSMcast.hpp"
+#include "attocubeIDSPublish.hpp"
+#include "attocubeIDSRpc.hpp"
+#include "attocubeIDSSeqlock.hpp"
+#include "attocubeIDSShm.h"
+#include "attocubeIDSSnapshot.h"
+#include "attocubeIDSTransport.hpp"
 
-namespace Method {
-inline constexpr std::string_view AxisDisplacement = "com.attocube.ids.displacement.getAxisDisplacement";
-inline constexpr std::string_view AxesDisplacement = "com.attocube.ids.displacement.getAxesDisplacement";
-inline constexpr std::string_view AbsolutePosition = "com.attocube.ids.displacement.getAbsolutePosition";
-inline constexpr std::string_view AbsolutePositions = "com.attocube.ids.displacement.getAbsolutePositions";
-inline constexpr std::string_view ReferencePositions = "com.attocube.ids.displacement.getReferencePositions";
-inline constexpr std::string_view MeasurementEnabled = "com.attocube.ids.displacement.getMeasurementEnabled";
-inline constexpr std::string_view CurrentMode = "com.attocube.ids.system.getCurrentMode";
-inline constexpr std::string_view DeviceType = "com.attocube.ids.system.getDeviceType";
-inline constexpr std::string_view FpgaVersion = "com.attocube.ids.system.getFpgaVersion";
-inline constexpr std::string_view StartMeasurement = "com.attocube.ids.system.startMeasurement";
-inline constexpr std::string_view StopMeasurement = "com.attocube.ids.system.stopMeasurement";
-}; // namespace Method
+using json = nlohmann::json;
 
 // asyn parameter names
-inline constexpr char AXIS0_DISPLACEMENT_STR[] = "AXIS0_DISPLACEMENT";
-inline constexpr char AXIS1_DISPLACEMENT_STR[] = "AXIS1_DISPLACEMENT";
-inline constexpr char AXIS2_DISPLACEMENT_STR[] = "AXIS2_DISPLACEMENT";
-inline constexpr char AXIS0_ABSOLUTE_POS_STR[] = "AXIS0_ABSOLUTE_POS";
-inline constexpr char AXIS1_ABSOLUTE_POS_STR[] = "AXIS1_ABSOLUTE_POS";
-inline constexpr char AXIS2_ABSOLUTE_POS_STR[] = "AXIS2_ABSOLUTE_POS";
-inline constexpr char AXIS0_REFERENCE_POS_STR[] = "AXIS0_REFERENCE_POS";
-inline constexpr char AXIS1_REFERENCE_POS_STR[] = "AXIS1_REFERENCE_POS";
-inline constexpr char AXIS2_REFERENCE_POS_STR[] = "AXIS2_REFERENCE_POS";
+inline constexpr const char* AXIS_DISPLACEMENT_STR[] = {"AXIS0_DISPLACEMENT", "AXIS1_DISPLACEMENT",
+                                                        "AXIS2_DISPLACEMENT"};
+inline constexpr const char* AXIS_ABSOLUTE_POS_STR[] = {"AXIS0_ABSOLUTE_POS", "AXIS1_ABSOLUTE_POS",
+                                                        "AXIS2_ABSOLUTE_POS"};
+inline constexpr const char* AXIS_REFERENCE_POS_STR[] = {"AXIS0_REFERENCE_POS", "AXIS1_REFERENCE_POS",
+                                                         "AXIS2_REFERENCE_POS"};
+inline constexpr char AXIS_ENABLE_STR[] = "AXIS_ENABLE";
 inline constexpr char MEASUREMENT_ENABLED_STR[] = "MEASUREMENT_ENABLED";
 inline constexpr char POLL_PERIOD_STR[] = "POLL_PERIOD";
 inline constexpr char SUSPEND_POLLER_STR[] = "SUSPEND_POLLER";
@@ -40,70 +55,719 @@ inline constexpr char DEVICE_TYPE_STR[] = "DEVICE_TYPE";
 inline constexpr char FPGA_VERSION_STR[] = "FPGA_VERSION";
 inline constexpr char START_MEASUREMENT_STR[] = "START_MEASUREMENT";
 inline constexpr char STOP_MEASUREMENT_STR[] = "STOP_MEASUREMENT";
+inline constexpr char CMD_LATENCY_STR[] = "CMD_LATENCY";
+inline constexpr char CMD_ERR_NO_STR[] = "CMD_ERR_NO";
+inline constexpr char PUBLISH_RATE_STR[] = "PUBLISH_RATE";
+inline constexpr char PUBLISH_MODE_STR[] = "PUBLISH_MODE";
+inline constexpr const char* RPC_ERRORS_STR[] = {nullptr, "RPC_ERR_TIMEOUT", "RPC_ERR_TRANSPORT", "RPC_ERR_FRAMING",
+                                                 "RPC_ERR_PARSE", "RPC_ERR_TYPE", "RPC_ERR_REMOTE"};
+inline constexpr char RPC_LAST_ERR_CODE_STR[] = "RPC_LAST_ERR_CODE";
+inline constexpr char RPC_LAST_ERR_MSG_STR[] = "RPC_LAST_ERR_MSG";
+inline constexpr char HEARTBEAT_AGE_STR[] = "HEARTBEAT_AGE";
+inline constexpr char STALL_COUNT_STR[] = "STALL_COUNT";
+
+// asyn parameter names of the per-axis conversion to engineering units (see AxisConversion)
+inline constexpr const char* AXIS_SCALE_STR[] = {"AXIS0_SCALE", "AXIS1_SCALE", "AXIS2_SCALE"};
+inline constexpr const char* AXIS_OFFSET_STR[] = {"AXIS0_OFFSET", "AXIS1_OFFSET", "AXIS2_OFFSET"};
+inline constexpr const char* AXIS_POLY2_STR[] = {"AXIS0_POLY2", "AXIS1_POLY2", "AXIS2_POLY2"};
+inline constexpr const char* AXIS_POLY3_STR[] = {"AXIS0_POLY3", "AXIS1_POLY3", "AXIS2_POLY3"};
+inline constexpr const char* AXIS_DISPLACEMENT_EGU_STR[] = {"AXIS0_DISPLACEMENT_EGU", "AXIS1_DISPLACEMENT_EGU",
+                                                            "AXIS2_DISPLACEMENT_EGU"};
+inline constexpr const char* AXIS_ABSOLUTE_POS_EGU_STR[] = {"AXIS0_ABSOLUTE_POS_EGU", "AXIS1_ABSOLUTE_POS_EGU",
+                                                            "AXIS2_ABSOLUTE_POS_EGU"};
+
+// asyn parameter names of the motion estimator (see MotionEstimator)
+inline constexpr const char* AXIS_VELOCITY_STR[] = {"AXIS0_VELOCITY", "AXIS1_VELOCITY", "AXIS2_VELOCITY"};
+inline constexpr const char* AXIS_ACCELERATION_STR[] = {"AXIS0_ACCELERATION", "AXIS1_ACCELERATION",
+                                                        "AXIS2_ACCELERATION"};
+inline constexpr char EST_MODE_STR[] = "EST_MODE";
+inline constexpr char EST_WINDOW_STR[] = "EST_WINDOW";
+inline constexpr char EST_ALPHA_STR[] = "EST_ALPHA";
+inline constexpr char EST_BETA_STR[] = "EST_BETA";
+inline constexpr char EST_GAMMA_STR[] = "EST_GAMMA";
+
+// asyn parameter names of the per-axis filter chain (see FilterChain)
+inline constexpr const char* AXIS_FILTER_STR[] = {"AXIS0_FILTER", "AXIS1_FILTER", "AXIS2_FILTER"};
+inline constexpr const char* AXIS_FILTERED_STR[] = {"AXIS0_FILTERED", "AXIS1_FILTERED", "AXIS2_FILTERED"};
+
+// asyn parameter name formats of the derived quantity slots, %zu is the slot number
+inline constexpr char DERIVED_VALUE_FMT[] = "DERIVED%zu_VALUE";
+inline constexpr char DERIVED_EXPR_FMT[] = "DERIVED%zu_EXPR";
+
+// asyn parameter names of additional device quantities (see AttocubeIDS::add_quantity)
+inline constexpr const char* AXIS_CONTRAST_STR[] = {"AXIS0_CONTRAST", "AXIS1_CONTRAST", "AXIS2_CONTRAST"};
+inline constexpr const char* AXIS_BASELINE_STR[] = {"AXIS0_BASELINE", "AXIS1_BASELINE", "AXIS2_BASELINE"};
+inline constexpr char ADJUSTMENT_ENABLED_STR[] = "ADJUSTMENT_ENABLED";
+inline constexpr char ECU_CONNECTED_STR[] = "ECU_CONNECTED";
+inline constexpr char ECU_TEMPERATURE_STR[] = "ECU_TEMPERATURE";
+inline constexpr char ECU_HUMIDITY_STR[] = "ECU_HUMIDITY";
+inline constexpr char ECU_PRESSURE_STR[] = "ECU_PRESSURE";
+inline constexpr char ECU_REFRACTIVE_INDEX_STR[] = "ECU_REFRACTIVE_INDEX";
+inline constexpr char PILOT_LASER_ENABLED_STR[] = "PILOT_LASER_ENABLED";
 
-inline constexpr size_t IO_BUFFER_SIZE = 512;
 inline constexpr double IO_TIMEOUT = 1.0;
+inline constexpr size_t IO_CONTEXTS = 4; ///< Requests that can be in flight at once on a connection.
+inline constexpr size_t MAX_CONNECTIONS = 4; ///< Connections a port may open to its controller.
 inline constexpr double POLL_PERIOD_MIN = 0.01;
-inline constexpr size_t NUM_AXES = 3;
+inline constexpr double CONNECT_RETRY_PERIOD = 5.0; ///< Between attempts to connect or read the static data (sec).
+inline constexpr double SHUTDOWN_TIMEOUT = 2 * IO_TIMEOUT; ///< IOC exit waits this long for a poll cycle (sec).
+inline constexpr double WATCHDOG_PERIOD = 0.5;      ///< How often the watchdog checks the heartbeat (sec).
+inline constexpr double WATCHDOG_STALL_MIN = 5.0;   ///< Shortest heartbeat age taken as a stall (sec).
+inline constexpr double WATCHDOG_STALL_CYCLES = 10; ///< Missed poll periods taken as a stall.
+inline constexpr double READ_INTEREST_TIMEOUT = 30.0; ///< A read keeps a parameter active this long (sec).
+inline constexpr size_t MAX_DERIVED = 8; ///< Number of derived quantity slots.
+inline constexpr size_t MAX_EST_WINDOW = 32; ///< Largest finite difference window of the motion estimator.
 
-class AttocubeIDS : public asynPortDriver {
+/// @brief When an additional device quantity is read from the controller.
+enum class FetchPolicy {
+    OnDemand,   ///< Fetched when a record reads one of its parameters (periodic scan or processing).
+    Periodic,   ///< Fetched at its own period while a client is interested.
+    Subscribed, ///< Fetched every poll cycle while a client is interested.
+};
+
+/// @brief An additional device quantity: one RPC feeding one or more asyn parameters.
+struct Quantity {
+    FetchPolicy policy;
+    std::chrono::steady_clock::duration period;          ///< Fetch period (Periodic only).
+    std::vector<int> params;                              ///< asyn parameters fed by the RPC.
+    std::function<bool()> fetch;                          ///< Does the RPC and sets the parameters.
+    std::chrono::steady_clock::time_point next_fetch{};   ///< Earliest time of the next Periodic fetch.
+    int axis = -1;                                        ///< Axis the quantity belongs to, -1 if none.
+};
+
+/// @brief Tracks which asyn parameters clients are interested in.
+///
+/// A parameter is active while it has interrupt subscribers (I/O Intr records, callbacks of
+/// other drivers) or was read by a client within READ_INTEREST_TIMEOUT. Bindings made through
+/// drvUserCreate are counted too so report() can show parameters nobody uses. All counters are
+/// atomic since registration happens outside the port lock.
+class InterestTracker {
   public:
-    AttocubeIDS(const char* conn_port, const char* driver_port);
-    virtual void poll(void);
-    virtual asynStatus writeInt32(asynUser* pasynUser, epicsInt32 value);
-    // virtual asynStatus writeFloat64(asynUser* pasynUser, epicsFloat64 value);
+    void resize(size_t num_params) {
+        bound_ = std::make_unique<std::atomic<int>[]>(num_params);
+        subscribed_ = std::make_unique<std::atomic<int>[]>(num_params);
+        last_read_ = std::make_unique<std::atomic<int64_t>[]>(num_params);
+        for (size_t i = 0; i < num_params; i++) {
+            bound_[i] = 0;
+            subscribed_[i] = 0;
+            last_read_[i] = READ_NEVER;
+        }
+        size_ = num_params;
+    }
+
+    void bind(int param, int delta) {
+        if (valid(param))
+            bound_[param] += delta;
+    }
+    void subscribe(int param, int delta) {
+        if (valid(param))
+            subscribed_[param] += delta;
+    }
+    void touch(int param) {
+        if (valid(param))
+            last_read_[param] = now();
+    }
+
+    bool active(int param) const {
+        if (!valid(param))
+            return false;
+        return subscribed_[param] > 0 || now() - last_read_[param] < READ_INTEREST_TIMEOUT_NS;
+    }
+
+    template <typename Ids>
+    bool any_active(const Ids& params) const {
+        for (int id : params) {
+            if (active(id))
+                return true;
+        }
+        return false;
+    }
+
+    int bound(int param) const { return valid(param) ? bound_[param].load() : 0; }
+    int subscribed(int param) const { return valid(param) ? subscribed_[param].load() : 0; }
+    size_t size() const { return size_; }
 
   private:
-    asynUser* pasynUserDriver_;                   ///< Pointer to the asynUser for this driver.
-    std::array<char, IO_BUFFER_SIZE> in_buffer_;  ///< Input data buffer (received from device).
-    std::array<char, IO_BUFFER_SIZE> out_buffer_; ///< Output data buffer (sent to device).
-    size_t nbytesout_ = 0;                        ///< Number of bytes sent on the last write operation.
-    size_t nbytesin_ = 0;                         ///< Number of bytes received on the last read operation.
-    int eom_reason_ = 0;                          ///< Reason for End of Message (EOM) on last read.
-    epicsThreadId poller_thread_id_;              ///< Identifier for the background polling thread.
-    bool poller_should_suspend_ = false;          ///< Flag to request suspension of the poller thread.
-
-    // Some internal type aliases
-    using I64Array3 = std::array<int64_t, 3>; ///< 3-element 64-bit integer array (e.g., axes displacement).
-    using I64Array4 = std::array<int64_t, 4>; ///< 4-element 64-bit integer array.
-    using IntPair = std::tuple<int, int>;     ///< Pair of integers
-    using StringTuple = std::tuple<std::string>; ///< A single string in a tuple
-    using IntTuple = std::tuple<int>;            ///< A single int in a tuple
-
-    /// @brief Writes out_buffer_ to device and reads reply into in_buffer_
-    ///
-    /// @param write_len (Optional) Number of characters in out_buffer_ to write.
-    /// @return asynStatus.
-    asynStatus write_read(size_t write_len = IO_BUFFER_SIZE);
+    static constexpr int64_t READ_INTEREST_TIMEOUT_NS = static_cast<int64_t>(READ_INTEREST_TIMEOUT * 1e9);
+    static constexpr int64_t READ_NEVER = INT64_MIN / 2;
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+    bool valid(int param) const { return param >= 0 && static_cast<size_t>(param) < size_; }
+
+    size_t size_ = 0;
+    std::unique_ptr<std::atomic<int>[]> bound_;
+    std::unique_ptr<std::atomic<int>[]> subscribed_;
+    std::unique_ptr<std::atomic<int64_t>[]> last_read_;
+};
+
+/// @brief How requests reach the controller.
+enum class Transport {
+    Asyn,   ///< Through asyn IP ports, conn_port is their comma separated names.
+    Native, ///< Own sockets on the shared EventLoop, conn_port is "host:port".
+};
+
+class AttocubeIDS : public asynPortDriver {
+  public:
+    /// @param connections Sockets opened to the controller by the native transport, each asyn
+    /// IP port listed in conn_port is one connection.
+    AttocubeIDS(const char* conn_port, const char* driver_port, Transport transport = Transport::Asyn,
+                size_t connections = 1);
+    /// @brief Runs one poll cycle and schedules the next on the shared Executor.
+    ///
+    /// @param generation The poll chain the cycle belongs to, a cycle of an older chain than
+    /// poll_generation_ does nothing.
+    virtual void poll(uint64_t generation);
+
+    /// @brief Publishes the accumulated values and schedules the next publication.
+    ///
+    /// @param generation The publication chain this call belongs to, a chain ends when
+    /// PUBLISH_RATE changes and a new one is started.
+    void publish(uint64_t generation);
+
+    /// @brief Starts the poll cycles, the publications and the watchdog; does nothing if they
+    /// are running. Clears a suspension of the poller.
+    ///
+    /// @return false if a stop() that timed out still waits for its poll cycle to end.
+    bool start();
+
+    /// @brief Stops the acquisition and flushes the published values and the multicast batch.
+    ///
+    /// A running poll cycle skips its remaining RPCs and stop() waits up to timeout for it
+    /// to finish; start() can be called again afterwards, e.g. with new settings.
+    ///
+    /// @return false if the cycle did not finish in time; the stop is then completed by that
+    /// cycle when it ends, after which start() works again.
+    bool stop(double timeout);
+
+    /// @brief The startup handshake is done: the transport is set up and DEVICE_TYPE and
+    /// FPGA_VERSION were read.
+    bool initialized() const { return initialized_; }
+
+    virtual asynStatus writeInt32(asynUser* pasynUser, epicsInt32 value);
+    virtual asynStatus writeFloat64(asynUser* pasynUser, epicsFloat64 value);
+    virtual asynStatus writeOctet(asynUser* pasynUser, const char* value, size_t maxChars, size_t* nActual);
+    virtual asynStatus readInt32(asynUser* pasynUser, epicsInt32* value);
+    virtual asynStatus readInt64(asynUser* pasynUser, epicsInt64* value);
+    virtual asynStatus readFloat64(asynUser* pasynUser, epicsFloat64* value);
+    virtual asynStatus drvUserCreate(asynUser* pasynUser, const char* drvInfo, const char** pptypeName,
+                                     size_t* psize);
+    virtual asynStatus drvUserDestroy(asynUser* pasynUser);
+    virtual void report(FILE* fp, int details);
 
     /// @brief Constructs JSON-RPC formatted command, writes it to the device
     /// then reads the reply and attempts to parse it to json.
     ///
+    /// This is the untyped path for methods that are not in the Method registry. It is only
+    /// meant for interactive use (see AttocubeIDSCall), the driver itself always uses do_rpc.
+    /// Must be called with the driver locked.
+    ///
     /// @param method The JSON-RPC method to call
-    /// @param params (Optional) A JSON object for parameters to pass.
-    /// @return The parsed reply as a JSON object, std::nullopt on communication or parse error.
-    std::optional<json> write_read_json(std::string_view method, json params = json{});
+    /// @param params JSON text of the parameters to pass, empty for none.
+    /// @param reply Set to the reply, serialised again from the parsed tree.
+    /// @param error Set to a description of the problem on failure.
+    /// @return asynSuccess, or asynError if params is invalid, the exchange failed or the reply
+    /// is not valid JSON.
+    asynStatus write_read_json(std::string_view method, std::string_view params, std::string& reply,
+                               std::string& error);
+
+    /// @brief Compiles an expression into a derived quantity slot, replacing what was there.
+    ///
+    /// An empty expression clears the slot. Must be called with the driver locked.
+    ///
+    /// @param slot The slot, 0 to MAX_DERIVED-1.
+    /// @param expr The expression, see DerivedProgram.
+    /// @param error Set to a description of the problem on failure.
+    /// @return asynSuccess, or asynError if the slot or the expression is invalid.
+    asynStatus set_derived(size_t slot, std::string_view expr, std::string& error);
+
+    /// @brief Replaces the filter chain of an axis. Must be called with the driver locked.
+    ///
+    /// @param axis The axis, 0 to NUM_AXES-1.
+    /// @param spec The chain spec, see FilterChain. Empty disables filtering.
+    /// @param error Set to a description of the problem on failure.
+    /// @return asynSuccess, or asynError if the axis or the spec is invalid.
+    asynStatus set_filter(size_t axis, std::string_view spec, std::string& error);
+
+    /// @brief Starts publishing every displacement sample to a shared-memory ring.
+    ///
+    /// Replaces a ring set up earlier. Must be called with the driver locked.
+    ///
+    /// @param name POSIX shared-memory name, e.g. "/ids1", see attocubeIDSShm.h for readers.
+    /// @param num_slots Number of samples kept in the ring.
+    /// @return asynSuccess, or asynError if the segment could not be created.
+    asynStatus enable_shm(const char* name, size_t num_slots);
+
+    /// @brief Starts sending every displacement sample to a UDP multicast group.
+    ///
+    /// Replaces a publisher set up earlier. Must be called with the driver locked.
+    /// See McastPublisher for the parameters.
+    ///
+    /// @return asynSuccess, or asynError with error set if the socket could not be set up.
+    asynStatus enable_mcast(const std::string& group, int port, int samples_per_packet, int ttl,
+                            const std::string& iface, std::string& error);
+
+    /// @brief Copies the snapshot of the newest poll cycle without locking the driver.
+    ///
+    /// @return false if no snapshot was published yet.
+    bool read_snapshot(idsSnapshot& snapshot) const { return snapshot_.load(snapshot) != 0; }
+
+    /// @brief Makes the poller read the positions every cycle for snapshot readers.
+    void add_snapshot_reader() { snapshot_readers_++; }
+
+  private:
+    /// @brief A poll RPC sent ahead by start_rpc(). Each link has one per method, reused by
+    /// every cycle.
+    template <typename M>
+    struct AsyncRpc {
+        std::optional<IoContextPool::Lease> io; ///< Holds the buffers until finish_rpc().
+        NativeConnection::Exchange exchange;    ///< Filled in by the transport's event loop.
+    };
+
+    /// @brief One connection to the controller and the I/O contexts that use it.
+    struct Link {
+        std::string port;                         ///< asyn IP port, or "host:port" for native.
+        std::unique_ptr<NativeConnection> native; ///< Set once the address is resolved.
+        IoContextPool pool{IO_CONTEXTS};          ///< Requests in flight on this connection.
+        /// Poll RPCs sent ahead on this connection, see start_rpc().
+        std::tuple<AsyncRpc<Method::AbsolutePositions>, AsyncRpc<Method::ReferencePositions>,
+                   AsyncRpc<Method::MeasurementEnabled>>
+            async;
+    };
+
+    const std::string conn_port_;                 ///< asyn IP port or "host:port" of the controller.
+    const Transport transport_;                   ///< How requests reach the controller.
+    std::atomic<bool> connected_{false};          ///< The transport is set up, see connect_transport().
+    std::chrono::steady_clock::time_point next_connect_{}; ///< Earliest time of the next connection attempt.
+    std::optional<std::string> device_type_;      ///< DEVICE_TYPE, once the controller replied.
+    std::optional<std::string> fpga_version_;     ///< FPGA_VERSION, once the controller replied.
+    std::atomic<bool> initialized_{false};        ///< Connected and the static data read, polling may start.
+    const std::chrono::steady_clock::time_point created_ = std::chrono::steady_clock::now();
+    double init_seconds_ = 0.0;                   ///< From construction to initialized_.
+    unsigned init_attempts_ = 0;                  ///< Connection and static data attempts so far.
+    std::vector<std::unique_ptr<Link>> links_;    ///< The first reads the displacement, see link_for().
+    std::atomic<size_t> next_shared_link_{0};     ///< Turns of the links shared by the other RPCs.
+    Executor& executor_;                          ///< Runs the poll cycles and publications.
+    uint64_t publish_generation_ = 0;             ///< Current publication chain, see publish().
+    PublishAccumulator published_;                ///< Fast poll results waiting to be published.
+    epicsTimeStamp decimated_time_{};             ///< Time of the newest decimated sample.
+    bool poller_should_suspend_ = false;          ///< Flag to request suspension of the poller.
+    bool poller_suspended_ = false;               ///< No poll cycle is scheduled until resumed.
+    uint64_t poll_generation_ = 0;                ///< Current poll chain, see poll().
+    bool acquiring_ = false;                      ///< Between start() and stop().
+    std::atomic<bool> stopping_{false};           ///< Set by stop(), ends the poll cycle between RPCs.
+    std::atomic<bool> cycle_active_{false};       ///< A poll cycle is running.
+    epicsEvent cycle_done_;                       ///< Signalled when a poll cycle ends.
+    std::atomic<bool> stop_late_{false};          ///< stop() gave up waiting, the cycle completes it.
+    epicsTimerId watchdog_timer_ = nullptr;       ///< Runs check_heartbeat() every WATCHDOG_PERIOD.
+    std::atomic<int64_t> heartbeat_ns_{0};        ///< Steady clock time the last poll cycle completed.
+    int64_t cycle_start_ns_ = 0;                  ///< Steady clock time the last poll cycle started.
+    std::atomic<double> stall_timeout_{WATCHDOG_STALL_MIN}; ///< Heartbeat age taken as a stall (sec).
+    std::atomic<bool> watching_{false};           ///< The poller is meant to run, so it can stall.
+    std::atomic<bool> stalled_{false};            ///< No heartbeat within stall_timeout_.
+    std::atomic<uint32_t> stalls_{0};             ///< Stalls detected since the IOC started.
+    bool data_invalid_ = false;                   ///< data_params_ are in INVALID alarm.
+    std::vector<int> data_params_;                ///< Params with values read from the controller.
+    std::vector<Quantity> quantities_;            ///< Additional device quantities.
+    std::vector<int> quantity_of_param_;          ///< Index into quantities_ for each param, -1 if none.
+    InterestTracker interest_;                    ///< Which params clients are interested in.
+    AxisConversion<NUM_AXES> conversion_;         ///< Raw positions to engineering units.
+    std::array<std::optional<DerivedProgram>, MAX_DERIVED> derived_; ///< Compiled derived quantities.
+    std::array<MotionEstimator<MAX_EST_WINDOW>, NUM_AXES> estimators_; ///< Velocity and acceleration.
+    std::array<FilterChain, NUM_AXES> filters_;   ///< Filter chain applied to each displacement sample.
+    std::unique_ptr<ShmWriter> shm_;              ///< Shared-memory ring of raw displacements, if enabled.
+    std::unique_ptr<McastPublisher> mcast_;       ///< Multicast stream of raw displacements, if enabled.
+    Seqlock<idsSnapshot> snapshot_;               ///< Positions of the newest poll cycle for other drivers.
+    std::atomic<int> snapshot_readers_{0};        ///< Number of idsSnapshotFind calls for this port.
+    uint64_t cycle_ = 0;                          ///< Poll cycles run so far.
+    uint32_t axis_enable_ = ALL_AXES;             ///< Axes that are fetched and published, see AXIS_ENABLE.
+    std::vector<int> disp_params_;                ///< Params fed by AxesDisplacement for the enabled axes.
+    std::vector<int> abs_params_;                 ///< Params fed by AbsolutePositions for the enabled axes.
+    std::vector<int> ref_params_;                 ///< Params fed by ReferencePositions for the enabled axes.
+    std::optional<std::string> current_mode_;     ///< Last value of the CURRENT_MODE param.
+    std::atomic<int> commands_waiting_{0};        ///< Int32/Float64 writes waiting for or holding the lock.
+    epicsEvent command_done_;                     ///< Signalled whenever an Int32 or Float64 write finishes.
+    double command_latency_max_ = 0.0;            ///< Largest command latency seen, in ms.
+    static thread_local std::chrono::steady_clock::time_point command_start_; ///< When this thread's write arrived.
+    static thread_local AttocubeIDS* cycle_owner_; ///< Port whose poll cycle runs on this thread.
+    std::array<std::atomic<uint32_t>, RpcCodec::NUM_RPC_ERRORS> rpc_errors_{}; ///< Failed RPCs by RpcError.
+    std::mutex remote_error_mutex_;               ///< Guards the remote error below.
+    int64_t remote_error_code_ = 0;               ///< Code of the last JSON-RPC error from the controller.
+    std::string remote_error_message_;            ///< Message of the last JSON-RPC error from the controller.
+    bool remote_error_fresh_ = false;             ///< The remote error changed since it was last published.
+    size_t rpcs_done_ = 0;                        ///< Poll cycle RPCs sent to the controller.
+    size_t rpcs_skipped_ = 0;                     ///< Poll cycle RPCs skipped for lack of interest.
+
+    // Copies of the standard interfaces with interrupt registration and Int32/Float64 writes hooked,
+    // see hook_interrupts()
+    asynInt32 int32_hooked_;
+    asynInt64 int64_hooked_;
+    asynFloat64 float64_hooked_;
+    asynOctet octet_hooked_;
+    std::tuple<const asynInt32*, const asynInt64*, const asynFloat64*, const asynOctet*> base_interfaces_;
+
+    /// @brief Redirects interrupt register/cancel of the standard interfaces through this driver
+    /// so interest_ sees every subscriber come and go, and Int32 and Float64 writes so the poller
+    /// can give way to them (see yield_to_commands()) and their latency is known.
+    void hook_interrupts();
+
+    /// @brief Lets waiting commands run before the poller sends its next RPC.
+    ///
+    /// Operator commands arrive as Int32 and Float64 writes, which need the driver lock that the poller
+    /// holds for its whole cycle. Called by the poller with the lock held between RPCs, this
+    /// releases the lock until no command is waiting any more, so a command waits for at most
+    /// one RPC instead of a full poll cycle.
+    void yield_to_commands();
+
+    /// @brief Notes when a write arrives and lets the poller know about it while it waits for
+    /// the driver lock.
+    template <typename Interface, typename T>
+    static asynStatus write_hook(void* drvPvt, asynUser* pasynUser, T value);
+
+    /// @brief Sets CMD_LATENCY to the time since the write of this thread arrived, called at
+    /// the end of writeInt32() and writeFloat64().
+    void record_command_latency();
 
-    /// @brief Sends a JSON-RPC command and attempts to parse the result into the requested type.
+    /// @brief Writes io.out to device and reads reply into io.in
     ///
-    /// @tparam T The expected return type of the RPC result.
-    /// @param method The JSON-RPC method to call.
-    /// @param params (Optional) A JSON object for parameters to pass.
-    /// @return The parsed value of type T if successful, std::nullopt on communication or parse error.
+    /// @param io The I/O context of this request.
+    /// @param write_len Number of characters in io.out to write.
+    /// @return asynStatus.
+    asynStatus write_read(IoContext& io, size_t write_len);
+
+    /// @brief Logs the failure of an exchange with the controller, nothing for asynSuccess.
+    void log_transport_error(asynStatus status);
+
+    /// @brief Sends a JSON-RPC command and decodes the result in the layout declared by the method.
+    ///
+    /// The request is encoded and the reply decoded directly in the buffers of an I/O context
+    /// taken from the pool of link_for<M>() for this call only, without building a json object.
+    /// Since nothing else is shared, this is safe to call from any thread without the driver lock.
+    /// Parameter types are checked against the method at compile time.
+    ///
+    /// @tparam M The method to call, one of the types in the Method namespace.
+    /// @param params Positional parameters, must match M::params_type.
+    /// @return The result as M::result_type if successful, std::nullopt on communication or parse error.
+    template <typename M, typename... Args>
+    std::optional<typename M::result_type> do_rpc(const Args&... params) {
+        static_assert(!RpcCodec::holds_views_v<typename M::result_type>,
+                      "results that view the reply buffer must be used with visit_rpc");
+        std::optional<typename M::result_type> result;
+        visit_rpc<M>([&result](const typename M::result_type& r) { result = r; }, params...);
+        return result;
+    }
+
+    /// @brief Like do_rpc, but hands the result to visit while the reply buffer is still held.
+    ///
+    /// This is the path for results holding RpcCodec::JsonString views, which must not outlive
+    /// the call.
+    ///
+    /// @return true if the reply was decoded and visit was called.
+    template <typename M, typename Visit, typename... Args>
+    bool visit_rpc(Visit&& visit, const Args&... params) {
+        auto io = link_for<M>().pool.acquire();
+        auto len = RpcCodec::encode<M>(io->out.data(), io->out.size(), params...);
+        if (!len) {
+            log_error(LogClass::Protocol, "json out is larger that buffer size!");
+            return false;
+        }
+        typename M::result_type result{};
+        // the poll cycle of this port waits for the reply without the driver lock, commands and
+        // the watchdog must not be held up by a controller that is slow to answer
+        const bool unlocked = cycle_owner_ == this;
+        if (unlocked)
+            unlock();
+        asynStatus status = write_read(*io, *len);
+        if (unlocked)
+            lock();
+        if (!decode_reply<M>(status, *io, result))
+            return false;
+        visit(result);
+        return true;
+    }
+
+    /// @brief Decodes the reply of an exchange that ended with status, counting a failed RPC.
+    ///
+    /// @return true if result was filled in.
+    template <typename M>
+    bool decode_reply(asynStatus status, const IoContext& io, typename M::result_type& result) {
+        RpcCodec::RemoteError remote;
+        RpcCodec::RpcError error = transport_error(status, io);
+        if (error == RpcCodec::RpcError::None)
+            error = RpcCodec::decode<M>(io.in.data(), io.in.data() + io.nbytesin, result, remote);
+        if (error != RpcCodec::RpcError::None) {
+            count_rpc_error(error, remote);
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief Sends a poll RPC ahead on one of the shared native connections, so that on a port
+    /// with several connections it travels while the poll cycle reads the displacement. The
+    /// transport's event loop reads the reply, no thread waits for it until finish_rpc().
+    ///
+    /// With a single connection, with asyn or if the connection is busy nothing is sent and
+    /// finish_rpc() sends the RPC itself.
+    ///
+    /// @param due The outcome of poll_due(), nothing is sent if false.
+    /// @return The slot to pass to finish_rpc(), nullptr if nothing was sent.
+    template <typename M>
+    AsyncRpc<M>* start_rpc(bool due) {
+        // on a single connection the RPCs would only queue up behind each other; a stop()
+        // since the cycle started skips the RPCs it has not sent yet
+        if (!due || links_.size() == 1 || !connected_ || stopping_)
+            return nullptr;
+        Link& link = shared_link();
+        if (!link.native)
+            return nullptr;
+        AsyncRpc<M>& rpc = std::get<AsyncRpc<M>>(link.async);
+        rpc.io.emplace(link.pool.acquire());
+        IoContext& io = **rpc.io;
+        auto len = RpcCodec::encode<M>(io.out.data(), io.out.size());
+        bool sent = false;
+        if (len) {
+            // sending may reconnect, which is not done with the driver lock held
+            const bool unlocked = cycle_owner_ == this;
+            if (unlocked)
+                unlock();
+            sent = link.native->begin(rpc.exchange, io.out.data(), *len, io.in.data(), io.in.size(),
+                                      IO_TIMEOUT, false);
+            if (unlocked)
+                lock();
+        }
+        if (!sent) {
+            rpc.io.reset();
+            return nullptr;
+        }
+        return &rpc;
+    }
+
+    /// @brief Picks up the reply of an RPC sent by start_rpc(), or calls do_rpc<M>() if it
+    /// was not sent ahead.
+    ///
+    /// @param due The due argument of start_rpc().
+    /// @return std::nullopt if the RPC failed, was not due or was skipped by stop().
+    template <typename M>
+    std::optional<typename M::result_type> finish_rpc(AsyncRpc<M>* rpc, bool due) {
+        if (!rpc)
+            return due && !stopping_ ? do_rpc<M>() : std::nullopt;
+        IoContext& io = **rpc->io;
+        const bool unlocked = cycle_owner_ == this;
+        if (unlocked)
+            unlock();
+        asynStatus status = io.native->end(rpc->exchange, &io.nbytesout, &io.nbytesin, &io.eom_reason);
+        if (unlocked)
+            lock();
+        log_transport_error(status);
+        std::optional<typename M::result_type> result;
+        if (typename M::result_type value{}; decode_reply<M>(status, io, value))
+            result = value;
+        rpc->io.reset();
+        return result;
+    }
+
+    /// @brief The connection of the RPCs that are not the displacement, they take turns on all
+    /// but the first.
+    Link& shared_link() {
+        if (links_.size() == 1)
+            return *links_.front();
+        return *links_[1 + next_shared_link_.fetch_add(1, std::memory_order_relaxed) % (links_.size() - 1)];
+    }
+
+    /// @brief The connection an RPC of method M goes through: the displacement read every poll
+    /// cycle has the first to itself, so it never queues behind a slower query.
+    template <typename M>
+    Link& link_for() {
+        if constexpr (std::is_same_v<M, Method::AxesDisplacement>)
+            return *links_.front();
+        else
+            return shared_link();
+    }
+
+    /// @brief Classifies the outcome of write_read, RpcError::None if a complete reply arrived.
+    static RpcCodec::RpcError transport_error(asynStatus status, const IoContext& io);
+
+    /// @brief Counts a failed RPC. Safe to call without the driver lock.
+    ///
+    /// @param remote The controller's error, only used for RpcError::Remote.
+    void count_rpc_error(RpcCodec::RpcError error, const RpcCodec::RemoteError& remote);
+
+    /// @brief Copies the RPC error counters and the last remote error to their params.
+    void publish_rpc_errors();
+
+    /// @brief Connects the I/O contexts to the asyn ports, or resolves the native address.
+    ///
+    /// Called by the poll cycle with the lock held until it succeeds; the lock is released
+    /// while a native address is resolved.
+    bool connect_transport();
+
+    /// @brief Reads DEVICE_TYPE and FPGA_VERSION if they have not arrived yet.
+    ///
+    /// @return true once both arrived.
+    bool fetch_static_data();
+
+    /// @brief Ends the startup handshake, lets the poll cycles send RPCs and wakes up
+    /// AttocubeIDSWaitInit.
+    void mark_initialized();
+
+    /// @brief Called by the watchdog timer, notices a poller that stopped completing cycles.
+    ///
+    /// Runs on the timer queue thread, which also does the recovery: a poll cycle lets go of
+    /// the driver lock while it waits for the controller, so a stalled cycle does not hold it.
+    /// A port that is not initialized yet is retrying its handshake and is not watched.
+    void check_heartbeat();
+
+    /// @brief Marks the data params INVALID and starts a new poll chain after a stall.
+    ///
+    /// A new chain is only started if no cycle is running, a running one ends the stall itself.
+    void recover();
+
+    /// @brief Puts data_params_ into or out of INVALID/COMM alarm.
+    void set_data_invalid(bool invalid);
+
+    /// @brief Seconds since the last poll cycle completed.
+    double heartbeat_age() const;
+
+    /// @brief RPCs that failed to reach the controller, by timeout or transport error.
+    uint32_t link_error_count() const;
+
+    /// @brief Hands an error message to the shared Logger if ASYN_TRACE_ERROR is set on the
+    /// driver port, the replacement for asynPrint on the acquisition path.
+    template <typename... Args>
+    void log_error(LogClass cls, const char* fmt, Args... args) {
+        // pasynUserSelf never changes; the asynUsers of the I/O contexts are set up while
+        // other threads already log, and a native port has none
+        if (pasynTrace->getTraceMask(pasynUserSelf) & ASYN_TRACE_ERROR)
+            Logger::shared().log(cls, portName, fmt, args...);
+    }
+
+    /// @brief Sets a string param from a reply only if it differs from the cached value.
+    ///
+    /// @param id The param.
+    /// @param value The string in the reply.
+    /// @param cache The value last set, std::nullopt if none. Updated in place, so it stops
+    /// allocating once it has grown.
+    void set_string_param(int id, const RpcCodec::JsonString& value, std::optional<std::string>& cache);
+
+    /// @brief Registers an additional device quantity and creates its asyn parameters.
+    ///
+    /// The parameter types follow the result layout of M, e.g. an int64_t element becomes an
+    /// asynParamInt64 parameter.
+    ///
+    /// @tparam M The method that reads the quantity.
+    /// @tparam I Indices of the result elements that are published, one per name.
+    /// @param policy When the quantity is fetched.
+    /// @param period Fetch period in seconds, only used for FetchPolicy::Periodic.
+    /// @param names asyn parameter names, one per index in I.
+    /// @param args Parameters passed to M, e.g. the axis.
+    template <typename M, size_t... I, typename... Args>
+    void add_quantity(FetchPolicy policy, double period, std::array<const char*, sizeof...(I)> names,
+                      Args... args) {
+        Quantity q;
+        q.policy = policy;
+        q.period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(period));
+        size_t k = 0;
+        (q.params.push_back(
+             create_quantity_param(names[k++], param_type<std::tuple_element_t<I, typename M::result_type>>())),
+         ...);
+        q.fetch = [this, ids = q.params, args...]() {
+            auto result = do_rpc<M>(args...);
+            if (!result)
+                return false;
+            size_t k = 0;
+            (set_param(ids[k++], std::get<I>(*result)), ...);
+            return true;
+        };
+        for (int id : q.params)
+            quantity_of_param_[id] = quantities_.size();
+        quantities_.push_back(std::move(q));
+    }
+
+    /// @brief Creates a parameter for a quantity and grows the lookup tables to cover it.
+    int create_quantity_param(const char* name, asynParamType type);
+
     template <typename T>
-    std::optional<T> do_rpc(std::string_view method, json params = json{}) {
-        if (auto data = write_read_json(method); data) {
-            if (data->contains("result")) {
-                try {
-                    return data.value()["result"].get<T>();
-                } catch (...) {
-                    return std::nullopt;
-                }
-            }
+    static constexpr asynParamType param_type() {
+        if constexpr (std::is_same_v<T, int64_t>)
+            return asynParamInt64;
+        else if constexpr (std::is_floating_point_v<T>)
+            return asynParamFloat64;
+        else if constexpr (std::is_same_v<T, std::string>)
+            return asynParamOctet;
+        else
+            return asynParamInt32;
+    }
+
+    void set_param(int id, int value) { setIntegerParam(id, value); }
+    void set_param(int id, int64_t value) { setInteger64Param(id, value); }
+    void set_param(int id, double value) { setDoubleParam(id, value); }
+    void set_param(int id, const std::string& value) { setStringParam(id, value); }
+
+    /// @brief Fetches the Periodic and Subscribed quantities that are due and watched.
+    void fetch_quantities();
+
+    /// @brief Sets the accumulated fast poll results in the param library, see PUBLISH_MODE.
+    void flush_published();
+
+    /// @brief The part of stop() after the poll cycle ended: ends the chains and flushes the
+    /// sinks. Called with the lock held.
+    void finish_stop();
+
+    /// @brief Applies an axis enable mask, rebuilding the param lists the poll cycle checks.
+    void set_axis_enable(uint32_t mask);
+
+    /// @brief Applies the estimator params to all axes and restarts the estimates.
+    void configure_estimators();
+
+    /// @brief True if an active derived quantity reads one of the inputs in mask.
+    bool derived_wants(uint32_t mask) const;
+
+    /// @brief Evaluates the active derived quantities whose inputs are all valid.
+    void evaluate_derived(const DerivedInputs& inputs, uint32_t valid);
+
+    /// @brief Called before a parameter is read by a client, fetches OnDemand quantities.
+    void fetch_on_read(int param);
+
+    /// @brief Calls an RPC from the poll cycle only if one of the params it feeds is active.
+    ///
+    /// @param params The params fed by the RPC.
+    /// @param also_wanted Set if something other than params needs the result this cycle.
+    ///
+    /// @return The result of the RPC, std::nullopt if it failed or was skipped.
+    template <typename M, typename Ids>
+    std::optional<typename M::result_type> poll_rpc(const Ids& params, bool also_wanted = false) {
+        if (!poll_due(params, also_wanted))
+            return std::nullopt;
+        return do_rpc<M>();
+    }
+
+    /// @brief The poll_rpc decision on its own: counts the RPC as sent or skipped and lets
+    /// waiting commands go first if it is sent.
+    template <typename Ids>
+    bool poll_due(const Ids& params, bool also_wanted = false) {
+        if (stopping_ || !initialized_)
+            return false;
+        if (!also_wanted && !interest_.any_active(params)) {
+            rpcs_skipped_++;
+            return false;
         }
-        return std::nullopt;
+        rpcs_done_++;
+        yield_to_commands();
+        return true;
     }
 
+    template <typename Interface, typename Callback>
+    static asynStatus register_interrupt_hook(void* drvPvt, asynUser* pasynUser, Callback callback, void* userPvt,
+                                              void** registrarPvt);
+    template <typename Interface>
+    static asynStatus cancel_interrupt_hook(void* drvPvt, asynUser* pasynUser, void* registrarPvt);
+    template <typename Interface>
+    static void hook_interface(asynInterface& iface, Interface& hooked, const Interface*& base);
+
   protected:
     // Indices in asyn parameter library
     int resumePollerId_;
@@ -114,14 +778,35 @@ class AttocubeIDS : public asynPortDriver {
     int fpgaVersionId_;
     int startMeasurementId_;
     int stopMeasurementId_;
+    int cmdLatencyId_;
+    int cmdErrNoId_;
+    int publishRateId_;
+    int publishModeId_;
+    std::array<int, RpcCodec::NUM_RPC_ERRORS> rpcErrorsId_{};
+    int rpcLastErrCodeId_;
+    int rpcLastErrMsgId_;
+    int heartbeatAgeId_;
+    int stallCountId_;
     int measurementEnabledId_;
-    int axis0DisplacementId_;
-    int axis1DisplacementId_;
-    int axis2DisplacementId_;
-    int axis0AbsolutePosId_;
-    int axis1AbsolutePosId_;
-    int axis2AbsolutePosId_;
-    int axis0ReferencePosId_;
-    int axis1ReferencePosId_;
-    int axis2ReferencePosId_;
+    int axisEnableId_;
+    std::array<int, NUM_AXES> axisDisplacementId_;
+    std::array<int, NUM_AXES> axisAbsolutePosId_;
+    std::array<int, NUM_AXES> axisReferencePosId_;
+    std::array<int, NUM_AXES> axisScaleId_;
+    std::array<int, NUM_AXES> axisOffsetId_;
+    std::array<int, NUM_AXES> axisPoly2Id_;
+    std::array<int, NUM_AXES> axisPoly3Id_;
+    std::array<int, NUM_AXES> axisDisplacementEguId_;
+    std::array<int, NUM_AXES> axisAbsolutePosEguId_;
+    std::array<int, NUM_AXES> axisVelocityId_;
+    std::array<int, NUM_AXES> axisAccelerationId_;
+    std::array<int, NUM_AXES> axisFilterId_;
+    std::array<int, NUM_AXES> axisFilteredId_;
+    int estModeId_;
+    int estWindowId_;
+    int estAlphaId_;
+    int estBetaId_;
+    int estGammaId_;
+    std::array<int, MAX_DERIVED> derivedValueId_;
+    std::array<int, MAX_DERIVED> derivedExprId_;
 };
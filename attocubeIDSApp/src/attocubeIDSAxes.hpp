@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+inline constexpr size_t DEVICE_AXES = 3; ///< Axes in the replies of the controller's all-axes methods.
+
+// Number of axes the driver handles, e.g. -DATTOCUBE_IDS_NUM_AXES=1 in USR_CPPFLAGS for a
+// single-axis setup. Axes beyond it are neither converted nor published.
+#ifndef ATTOCUBE_IDS_NUM_AXES
+#define ATTOCUBE_IDS_NUM_AXES 3
+#endif
+inline constexpr size_t NUM_AXES = ATTOCUBE_IDS_NUM_AXES;
+static_assert(NUM_AXES >= 1 && NUM_AXES <= DEVICE_AXES, "ATTOCUBE_IDS_NUM_AXES must be 1 to 3");
+
+inline constexpr uint32_t ALL_AXES = (1u << NUM_AXES) - 1; ///< Axis enable mask with every axis set.
+
+/// @brief True if the axis is set in an axis enable mask.
+constexpr bool axis_enabled(uint32_t mask, size_t axis) { return (mask >> axis) & 1u; }
+
+template <typename F, size_t... I>
+constexpr void for_each_axis_impl(F& f, std::index_sequence<I...>) {
+    (f(std::integral_constant<size_t, I>{}), ...);
+}
+
+/// @brief Calls f(std::integral_constant<size_t, axis>{}) for every axis, unrolled at compile
+/// time so the axis can index tuples.
+template <size_t N = NUM_AXES, typename F>
+constexpr void for_each_axis(F&& f) {
+    for_each_axis_impl(f, std::make_index_sequence<N>{});
+}
+
+/// @brief The per-axis values of a reply laid out as (errNo, axis 0, axis 1, ...).
+template <size_t N = NUM_AXES, typename Result>
+std::array<int64_t, N> axis_values(const Result& result) {
+    static_assert(std::tuple_size_v<Result> >= N + 1, "reply has fewer axes than the driver");
+    std::array<int64_t, N> values;
+    for_each_axis<N>([&](auto axis) { values[axis] = std::get<axis + 1>(result); });
+    return values;
+}
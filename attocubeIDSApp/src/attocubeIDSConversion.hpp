@@ -0,0 +1,37 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Per-axis conversion of raw picometre positions to engineering units.
+///
+/// value = x + poly2 * x^2 + poly3 * x^3 + offset, with x = raw * scale
+///
+/// The default scale converts picometres to micrometres. The polynomial terms take up small
+/// non-linear corrections (e.g. cosine error), the offset a calibration zero. All axes are
+/// converted in one pass over contiguous coefficient arrays.
+///
+/// @tparam N Number of axes.
+template <size_t N>
+struct AxisConversion {
+    std::array<double, N> scale;
+    std::array<double, N> offset;
+    std::array<double, N> poly2;
+    std::array<double, N> poly3;
+
+    AxisConversion() {
+        scale.fill(DEFAULT_SCALE);
+        offset.fill(0.0);
+        poly2.fill(0.0);
+        poly3.fill(0.0);
+    }
+
+    void apply(const std::array<int64_t, N>& raw, std::array<double, N>& out) const {
+        for (size_t i = 0; i < N; i++) {
+            double x = static_cast<double>(raw[i]) * scale[i];
+            out[i] = x + x * x * (poly2[i] + poly3[i] * x) + offset[i];
+        }
+    }
+
+    static constexpr double DEFAULT_SCALE = 1e-6; ///< pm to um
+};
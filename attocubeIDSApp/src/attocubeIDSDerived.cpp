@@ -0,0 +1,261 @@
+#include <cctype>
+#include <charconv>
+#include <cmath>
+
+#include "attocubeIDSDerived.hpp"
+
+/// @brief Recursive descent compiler from expression text to a DerivedProgram.
+class DerivedCompiler {
+  public:
+    DerivedCompiler(std::string_view expr, std::string& error) : expr_(expr), error_(error) {}
+
+    std::optional<DerivedProgram> run() {
+        expression();
+        skip_ws();
+        if (ok_ && pos_ != expr_.size())
+            fail("unexpected character");
+        if (!ok_)
+            return std::nullopt;
+        return std::move(program_);
+    }
+
+  private:
+    using Op = DerivedProgram::Op;
+
+    std::string_view expr_;
+    std::string& error_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+    int depth_ = 0;
+    DerivedProgram program_;
+
+    void fail(const char* msg) {
+        if (ok_)
+            error_ = std::string(msg) + " at position " + std::to_string(pos_);
+        ok_ = false;
+    }
+
+    void skip_ws() {
+        while (pos_ < expr_.size() && std::isspace(static_cast<unsigned char>(expr_[pos_])))
+            pos_++;
+    }
+
+    bool accept(char c) {
+        skip_ws();
+        if (pos_ < expr_.size() && expr_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!accept(c))
+            fail(c == ')' ? "expected ')'" : "expected ','");
+    }
+
+    // Appends an instruction and tracks the stack depth it leaves behind
+    void emit(Op op, int stack_change, double value = 0.0, uint8_t input = 0, double (*func)(double) = nullptr) {
+        program_.code_.push_back({op, input, value, func});
+        depth_ += stack_change;
+        if (depth_ > static_cast<int>(DerivedProgram::MAX_STACK))
+            fail("expression too deeply nested");
+    }
+
+    void expression() {
+        term();
+        while (ok_) {
+            if (accept('+')) {
+                term();
+                emit(Op::Add, -1);
+            } else if (accept('-')) {
+                term();
+                emit(Op::Sub, -1);
+            } else {
+                break;
+            }
+        }
+    }
+
+    void term() {
+        unary();
+        while (ok_) {
+            if (accept('*')) {
+                unary();
+                emit(Op::Mul, -1);
+            } else if (accept('/')) {
+                unary();
+                emit(Op::Div, -1);
+            } else {
+                break;
+            }
+        }
+    }
+
+    void unary() {
+        if (accept('-')) {
+            unary();
+            emit(Op::Neg, 0);
+        } else if (accept('+')) {
+            unary();
+        } else {
+            power();
+        }
+    }
+
+    void power() {
+        primary();
+        if (ok_ && accept('^')) {
+            unary();
+            emit(Op::Pow, -1);
+        }
+    }
+
+    std::string_view identifier() {
+        size_t start = pos_;
+        while (pos_ < expr_.size() && (std::isalnum(static_cast<unsigned char>(expr_[pos_])) || expr_[pos_] == '_'))
+            pos_++;
+        return expr_.substr(start, pos_ - start);
+    }
+
+    void primary() {
+        skip_ws();
+        if (pos_ >= expr_.size()) {
+            fail("unexpected end of expression");
+            return;
+        }
+
+        char c = expr_[pos_];
+        if (c == '(') {
+            pos_++;
+            expression();
+            expect(')');
+            return;
+        }
+
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            double value;
+            auto [ptr, ec] = std::from_chars(expr_.data() + pos_, expr_.data() + expr_.size(), value);
+            if (ec != std::errc()) {
+                fail("invalid number");
+                return;
+            }
+            pos_ = ptr - expr_.data();
+            emit(Op::Const, +1, value);
+            return;
+        }
+
+        if (!std::isalpha(static_cast<unsigned char>(c))) {
+            fail("unexpected character");
+            return;
+        }
+
+        std::string_view name = identifier();
+        if (name.size() == 2 && (name[0] == 'd' || name[0] == 'p') && name[1] >= '0' && name[1] <= '2') {
+            auto input = static_cast<uint8_t>((name[0] == 'd' ? DERIVED_D0 : DERIVED_P0) + (name[1] - '0'));
+            program_.inputs_used_ |= 1u << input;
+            emit(Op::Input, +1, 0.0, input);
+            return;
+        }
+        if (name == "pi") {
+            emit(Op::Const, +1, 3.14159265358979323846);
+            return;
+        }
+        if (name == "atan2") {
+            if (!accept('(')) {
+                fail("expected '('");
+                return;
+            }
+            expression();
+            expect(',');
+            expression();
+            expect(')');
+            emit(Op::Atan2, -1);
+            return;
+        }
+
+        double (*func)(double) = function(name);
+        if (!func) {
+            fail("unknown identifier");
+            return;
+        }
+        if (!accept('(')) {
+            fail("expected '('");
+            return;
+        }
+        expression();
+        expect(')');
+        emit(Op::Func, 0, 0.0, 0, func);
+    }
+
+    static double (*function(std::string_view name))(double) {
+        if (name == "sin")
+            return [](double x) { return std::sin(x); };
+        if (name == "cos")
+            return [](double x) { return std::cos(x); };
+        if (name == "tan")
+            return [](double x) { return std::tan(x); };
+        if (name == "asin")
+            return [](double x) { return std::asin(x); };
+        if (name == "acos")
+            return [](double x) { return std::acos(x); };
+        if (name == "atan")
+            return [](double x) { return std::atan(x); };
+        if (name == "sqrt")
+            return [](double x) { return std::sqrt(x); };
+        if (name == "abs")
+            return [](double x) { return std::fabs(x); };
+        return nullptr;
+    }
+};
+
+std::optional<DerivedProgram> DerivedProgram::compile(std::string_view expr, std::string& error) {
+    return DerivedCompiler(expr, error).run();
+}
+
+double DerivedProgram::evaluate(const DerivedInputs& inputs) const {
+    std::array<double, MAX_STACK> stack;
+    size_t top = 0;
+
+    for (const Instr& in : code_) {
+        switch (in.op) {
+        case Op::Const:
+            stack[top++] = in.value;
+            break;
+        case Op::Input:
+            stack[top++] = inputs[in.input];
+            break;
+        case Op::Neg:
+            stack[top - 1] = -stack[top - 1];
+            break;
+        case Op::Add:
+            top--;
+            stack[top - 1] += stack[top];
+            break;
+        case Op::Sub:
+            top--;
+            stack[top - 1] -= stack[top];
+            break;
+        case Op::Mul:
+            top--;
+            stack[top - 1] *= stack[top];
+            break;
+        case Op::Div:
+            top--;
+            stack[top - 1] /= stack[top];
+            break;
+        case Op::Pow:
+            top--;
+            stack[top - 1] = std::pow(stack[top - 1], stack[top]);
+            break;
+        case Op::Func:
+            stack[top - 1] = in.func(stack[top - 1]);
+            break;
+        case Op::Atan2:
+            top--;
+            stack[top - 1] = std::atan2(stack[top - 1], stack[top]);
+            break;
+        }
+    }
+    return stack[0];
+}
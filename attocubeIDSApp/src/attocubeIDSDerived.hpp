@@ -0,0 +1,57 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Values a derived expression can refer to, all in engineering units.
+///
+/// d0..d2 are the converted displacements, p0..p2 the converted absolute positions.
+enum DerivedInput : uint8_t { DERIVED_D0, DERIVED_D1, DERIVED_D2, DERIVED_P0, DERIVED_P1, DERIVED_P2, NUM_DERIVED_INPUTS };
+
+using DerivedInputs = std::array<double, NUM_DERIVED_INPUTS>;
+
+/// @brief A derived quantity compiled to a flat stack program.
+///
+/// Expressions are compiled once when configured and then evaluated every poll cycle on the
+/// inputs of that cycle, e.g. a pitch angle from two parallel axes spaced 25 mm apart:
+///
+///     atan((d0 - d1) / 25000)
+///
+/// Supported are + - * / ^, parentheses, numbers, pi, the inputs d0 d1 d2 p0 p1 p2 and the
+/// functions sin cos tan asin acos atan sqrt abs atan2(y, x).
+class DerivedProgram {
+  public:
+    /// @brief Compiles an expression.
+    ///
+    /// @param expr The expression.
+    /// @param error Set to a description of the problem if compilation fails.
+    /// @return The program, std::nullopt if the expression is invalid.
+    static std::optional<DerivedProgram> compile(std::string_view expr, std::string& error);
+
+    /// @brief Evaluates the program on one set of inputs. Does not allocate.
+    double evaluate(const DerivedInputs& inputs) const;
+
+    /// @brief Bit mask of the DerivedInput values the program reads.
+    uint32_t inputs_used() const { return inputs_used_; }
+
+    static constexpr size_t MAX_STACK = 16;
+
+  private:
+    enum class Op : uint8_t { Const, Input, Neg, Add, Sub, Mul, Div, Pow, Func, Atan2 };
+
+    struct Instr {
+        Op op;
+        uint8_t input;
+        double value;
+        double (*func)(double);
+    };
+
+    std::vector<Instr> code_;
+    uint32_t inputs_used_ = 0;
+
+    friend class DerivedCompiler;
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+/// @brief Velocity and acceleration of one axis.
+struct MotionEstimate {
+    double velocity = 0.0;
+    double acceleration = 0.0;
+};
+
+/// @brief Per-axis velocity and acceleration estimator on timestamped position samples.
+///
+/// Two methods are available:
+/// - FiniteDifference: velocity from the samples `window` apart, acceleration from the
+///   difference of two such velocities. The history is a fixed-size ring.
+/// - AlphaBeta: an alpha-beta-gamma tracking filter, i.e. a steady-state Kalman filter for a
+///   constant acceleration model. Less noisy at the cost of some lag.
+///
+/// The per-sample cost is constant and nothing is allocated after construction.
+///
+/// @tparam MAX_WINDOW Largest supported finite difference window.
+template <size_t MAX_WINDOW>
+class MotionEstimator {
+  public:
+    enum Mode { FiniteDifference = 0, AlphaBeta = 1 };
+
+    void configure(Mode mode, size_t window, double alpha, double beta, double gamma) {
+        mode_ = mode;
+        window_ = std::clamp<size_t>(window, 1, MAX_WINDOW);
+        alpha_ = alpha;
+        beta_ = beta;
+        gamma_ = gamma;
+        reset();
+    }
+
+    void reset() {
+        count_ = 0;
+        head_ = 0;
+        primed_ = false;
+        estimate_ = MotionEstimate{};
+    }
+
+    /// @brief Adds a sample and returns the updated estimate.
+    ///
+    /// @param t Sample time in seconds, must increase monotonically.
+    /// @param x Position at time t.
+    MotionEstimate update(double t, double x) {
+        if (mode_ == AlphaBeta)
+            update_alpha_beta(t, x);
+        else
+            update_finite_difference(t, x);
+        return estimate_;
+    }
+
+  private:
+    static constexpr size_t HISTORY = 2 * MAX_WINDOW + 1;
+
+    Mode mode_ = FiniteDifference;
+    size_t window_ = 1;
+    double alpha_ = 0.5;
+    double beta_ = 0.1;
+    double gamma_ = 0.01;
+
+    // finite difference history, head_ is the slot of the next sample
+    std::array<double, HISTORY> t_{};
+    std::array<double, HISTORY> x_{};
+    size_t head_ = 0;
+    size_t count_ = 0;
+
+    // alpha-beta-gamma state
+    bool primed_ = false;
+    double t_last_ = 0.0;
+    double x_est_ = 0.0;
+
+    MotionEstimate estimate_;
+
+    // index of the sample `back` samples before the newest one
+    size_t at(size_t back) const { return (head_ + HISTORY - 1 - back) % HISTORY; }
+
+    void update_finite_difference(double t, double x) {
+        if (count_ > 0 && t <= t_[at(0)])
+            return;
+        t_[head_] = t;
+        x_[head_] = x;
+        head_ = (head_ + 1) % HISTORY;
+        count_ = std::min(count_ + 1, HISTORY);
+
+        const size_t w = window_;
+        if (count_ > w) {
+            size_t i0 = at(0), i1 = at(w);
+            double v1 = (x_[i0] - x_[i1]) / (t_[i0] - t_[i1]);
+            estimate_.velocity = v1;
+            if (count_ > 2 * w) {
+                size_t i2 = at(2 * w);
+                double v0 = (x_[i1] - x_[i2]) / (t_[i1] - t_[i2]);
+                // the two velocities belong to the midpoints of their intervals
+                estimate_.acceleration = 2.0 * (v1 - v0) / (t_[i0] - t_[i2]);
+            }
+        }
+    }
+
+    void update_alpha_beta(double t, double x) {
+        if (!primed_) {
+            primed_ = true;
+            t_last_ = t;
+            x_est_ = x;
+            estimate_ = MotionEstimate{};
+            return;
+        }
+        double dt = t - t_last_;
+        if (dt <= 0.0)
+            return;
+        t_last_ = t;
+
+        double x_pred = x_est_ + estimate_.velocity * dt + 0.5 * estimate_.acceleration * dt * dt;
+        double v_pred = estimate_.velocity + estimate_.acceleration * dt;
+        double residual = x - x_pred;
+
+        x_est_ = x_pred + alpha_ * residual;
+        estimate_.velocity = v_pred + beta_ * residual / dt;
+        estimate_.acceleration += 2.0 * gamma_ * residual / (dt * dt);
+    }
+};
@@ -0,0 +1,193 @@
+#include <cstring>
+#include <utility>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <epicsThread.h>
+
+#include "attocubeIDSExecutor.hpp"
+
+static std::mutex shared_mutex;
+static Executor* shared_executor = nullptr;
+
+namespace {
+struct WorkerStart {
+    Executor* executor;
+    size_t index;
+};
+} // namespace
+
+Executor& Executor::shared() {
+    std::lock_guard<std::mutex> guard(shared_mutex);
+    if (!shared_executor)
+        shared_executor = new Executor(DEFAULT_EXECUTOR_THREADS, {});
+    return *shared_executor;
+}
+
+bool Executor::configure(size_t threads, const std::vector<int>& cpus, std::string& error) {
+    std::lock_guard<std::mutex> guard(shared_mutex);
+    if (shared_executor) {
+        error = "the executor is already running, configure it before the first AttocubeIDSConfig";
+        return false;
+    }
+    if (threads == 0) {
+        error = "at least one thread is needed";
+        return false;
+    }
+    for (int cpu : cpus) {
+        if (cpu < 0) {
+            error = "invalid CPU " + std::to_string(cpu);
+            return false;
+        }
+    }
+    shared_executor = new Executor(threads, cpus);
+    return true;
+}
+
+Executor::Executor(size_t threads, const std::vector<int>& cpus) : started_(Clock::now()) {
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+        if (!cpus.empty())
+            workers_.back()->cpu = cpus[i % cpus.size()];
+    }
+    // the executor lives as long as the IOC, so do the workers
+    for (size_t i = 0; i < threads; i++) {
+        std::string name = "AttocubeIDSExec" + std::to_string(i);
+        epicsThreadCreate(
+            name.c_str(), epicsThreadPriorityLow, epicsThreadGetStackSize(epicsThreadStackMedium),
+            [](void* arg) {
+                auto* start = static_cast<WorkerStart*>(arg);
+                Executor* executor = start->executor;
+                size_t index = start->index;
+                delete start;
+                executor->run(index);
+            },
+            new WorkerStart{this, i});
+    }
+}
+
+void Executor::submit(Task task) {
+    push(next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size(), std::move(task));
+}
+
+void Executor::submit_at(Clock::time_point when, Task task) {
+    {
+        std::lock_guard<std::mutex> guard(timer_mutex_);
+        timers_.push(Timed{when, timer_order_++, std::move(task)});
+    }
+    // the sleeping workers may have to wake up earlier than they planned
+    wake_.notify_all();
+}
+
+void Executor::push(size_t index, Task task) {
+    {
+        std::lock_guard<std::mutex> guard(workers_[index]->mutex);
+        workers_[index]->queue.push_back(std::move(task));
+    }
+    {
+        // counted under timer_mutex_ so a worker about to sleep cannot miss it
+        std::lock_guard<std::mutex> guard(timer_mutex_);
+        pending_++;
+    }
+    wake_.notify_one();
+}
+
+bool Executor::take(size_t index, Task& task) {
+    Worker& own = *workers_[index];
+    {
+        std::lock_guard<std::mutex> guard(own.mutex);
+        if (!own.queue.empty()) {
+            task = std::move(own.queue.back());
+            own.queue.pop_back();
+            pending_--;
+            return true;
+        }
+    }
+    // steal the oldest task of another worker, skipping queues that are busy right now
+    for (size_t i = 1; i < workers_.size(); i++) {
+        Worker& victim = *workers_[(index + i) % workers_.size()];
+        std::unique_lock<std::mutex> guard(victim.mutex, std::try_to_lock);
+        if (guard && !victim.queue.empty()) {
+            task = std::move(victim.queue.front());
+            victim.queue.pop_front();
+            pending_--;
+            own.steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Executor::run(size_t index) {
+    Worker& self = *workers_[index];
+#ifdef __linux__
+    if (self.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(self.cpu, &set);
+        if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+            printf("AttocubeIDSExecutor: could not pin worker %zu to CPU %d: %s\n", index, self.cpu, strerror(err));
+    }
+#endif
+
+    Task task;
+    while (true) {
+        // move timed tasks that are due to the own queue, so they can be stolen if this worker is slow
+        size_t moved = 0;
+        {
+            std::lock_guard<std::mutex> guard(timer_mutex_);
+            auto now = Clock::now();
+            while (!timers_.empty() && timers_.top().when <= now) {
+                {
+                    std::lock_guard<std::mutex> own_guard(self.mutex);
+                    self.queue.push_back(std::move(const_cast<Timed&>(timers_.top()).task));
+                }
+                pending_++;
+                moved++;
+                timers_.pop();
+            }
+        }
+        if (moved > 1)
+            wake_.notify_all();
+
+        if (take(index, task)) {
+            auto start = Clock::now();
+            task();
+            task = nullptr;
+            self.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            self.tasks++;
+            continue;
+        }
+
+        // sleep until the next timed task is due or something is submitted, then look again
+        std::unique_lock<std::mutex> guard(timer_mutex_);
+        if (pending_ > 0)
+            continue;
+        if (timers_.empty())
+            wake_.wait(guard);
+        else
+            wake_.wait_until(guard, timers_.top().when);
+    }
+}
+
+void Executor::report(FILE* fp) const {
+    double elapsed = std::chrono::duration<double>(Clock::now() - started_).count();
+    fprintf(fp, "AttocubeIDS executor: %zu workers, up %.0f s\n", workers_.size(), elapsed);
+    for (size_t i = 0; i < workers_.size(); i++) {
+        const Worker& w = *workers_[i];
+        size_t queued;
+        {
+            std::lock_guard<std::mutex> guard(w.mutex);
+            queued = w.queue.size();
+        }
+        double busy = w.busy_ns.load() * 1e-9;
+        fprintf(fp, "  worker %zu: cpu %s, %llu tasks, %llu stolen, busy %.1f%%, %zu queued\n", i,
+                w.cpu >= 0 ? std::to_string(w.cpu).c_str() : "any", static_cast<unsigned long long>(w.tasks.load()),
+                static_cast<unsigned long long>(w.steals.load()), elapsed > 0.0 ? 100.0 * busy / elapsed : 0.0,
+                queued);
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <vector>
+
+inline constexpr size_t DEFAULT_EXECUTOR_THREADS = 2; ///< Workers if AttocubeIDSExecutor is not called.
+
+/// @brief A pool of worker threads shared by all AttocubeIDS instances.
+///
+/// Instead of one mostly idle thread per controller, the poll cycles and publications of all
+/// instances run as tasks on a few workers. Each worker has its own queue; an idle worker
+/// takes timed tasks that are due and otherwise steals from the other queues, so one slow
+/// controller does not hold up the others while a worker is free.
+///
+/// Tasks run to completion and may block on I/O; the pool should have enough workers to
+/// cover the controllers that are expected to be waiting for a reply at the same time.
+class Executor {
+  public:
+    using Task = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief The shared executor, started with DEFAULT_EXECUTOR_THREADS if not configured.
+    static Executor& shared();
+
+    /// @brief Sets up the shared executor, only possible before it is first used.
+    ///
+    /// @param threads Number of workers.
+    /// @param cpus CPUs to pin the workers to, worker i runs on cpus[i % cpus.size()]. Empty
+    /// leaves the workers unpinned.
+    /// @param error Set to a description of the problem on failure.
+    /// @return false if the executor is already running or the arguments are invalid.
+    static bool configure(size_t threads, const std::vector<int>& cpus, std::string& error);
+
+    /// @brief Runs a task as soon as a worker is free.
+    void submit(Task task);
+
+    /// @brief Runs a task once the time has come.
+    void submit_at(Clock::time_point when, Task task);
+
+    /// @brief Prints the per-worker statistics.
+    void report(FILE* fp) const;
+
+    size_t size() const { return workers_.size(); }
+
+  private:
+    struct Worker {
+        mutable std::mutex mutex;
+        std::deque<Task> queue;
+        int cpu = -1;
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<int64_t> busy_ns{0};
+    };
+
+    struct Timed {
+        Clock::time_point when;
+        uint64_t order; ///< Keeps tasks due at the same time in submission order.
+        Task task;
+        bool operator>(const Timed& other) const {
+            return when != other.when ? when > other.when : order > other.order;
+        }
+    };
+
+    Executor(size_t threads, const std::vector<int>& cpus);
+    void run(size_t index);
+    void push(size_t index, Task task);
+    bool take(size_t index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_worker_{0};
+    std::atomic<int> pending_{0}; ///< Tasks sitting in worker queues.
+
+    std::mutex timer_mutex_;
+    std::condition_variable wake_;
+    std::priority_queue<Timed, std::vector<Timed>, std::greater<Timed>> timers_;
+    uint64_t timer_order_ = 0;
+
+    Clock::time_point started_;
+};
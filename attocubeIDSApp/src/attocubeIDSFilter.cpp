@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <vector>
+
+#include "attocubeIDSFilter.hpp"
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+        s.remove_prefix(1);
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+        s.remove_suffix(1);
+    return s;
+}
+
+// Splits a stage into its name and numeric arguments
+static bool parse_stage(std::string_view stage, std::string_view& name, std::vector<double>& args) {
+    args.clear();
+    size_t pos = 0;
+    auto next_token = [&]() {
+        while (pos < stage.size() && std::isspace(static_cast<unsigned char>(stage[pos])))
+            pos++;
+        size_t start = pos;
+        while (pos < stage.size() && !std::isspace(static_cast<unsigned char>(stage[pos])))
+            pos++;
+        return stage.substr(start, pos - start);
+    };
+
+    name = next_token();
+    for (std::string_view tok = next_token(); !tok.empty(); tok = next_token()) {
+        double value;
+        auto [ptr, ec] = std::from_chars(tok.data(), tok.data() + tok.size(), value);
+        if (ec != std::errc() || ptr != tok.data() + tok.size())
+            return false;
+        args.push_back(value);
+    }
+    return true;
+}
+
+// Second order sections from the Audio EQ Cookbook (R. Bristow-Johnson)
+static std::optional<FilterChain::Biquad> design(std::string_view kind, double f0, double q, double fs) {
+    if (f0 <= 0.0 || q <= 0.0 || fs <= 0.0 || f0 >= fs / 2)
+        return std::nullopt;
+    constexpr double PI = 3.14159265358979323846;
+    double w0 = 2.0 * PI * f0 / fs;
+    double cosw = std::cos(w0);
+    double alpha = std::sin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+
+    FilterChain::Biquad s;
+    if (kind == "lowpass") {
+        s.b0 = (1.0 - cosw) / 2.0 / a0;
+        s.b1 = (1.0 - cosw) / a0;
+        s.b2 = s.b0;
+    } else {
+        s.b0 = 1.0 / a0;
+        s.b1 = -2.0 * cosw / a0;
+        s.b2 = s.b0;
+    }
+    s.a1 = -2.0 * cosw / a0;
+    s.a2 = (1.0 - alpha) / a0;
+    return s;
+}
+
+std::optional<FilterChain> FilterChain::parse(std::string_view spec, std::string& error) {
+    FilterChain chain;
+    std::vector<double> args;
+
+    while (!spec.empty()) {
+        size_t end = spec.find(';');
+        std::string_view stage = trim(spec.substr(0, end));
+        spec = end == std::string_view::npos ? std::string_view() : spec.substr(end + 1);
+        if (stage.empty())
+            continue;
+
+        std::string_view name;
+        if (!parse_stage(stage, name, args)) {
+            error = "invalid number in '" + std::string(stage) + "'";
+            return std::nullopt;
+        }
+
+        if (name == "biquad" || name == "lowpass" || name == "notch") {
+            // process() runs the fir last, a spec listing it earlier would not do what it says
+            if (chain.num_taps_ > 0) {
+                error = "the fir stage must come after all biquad sections";
+                return std::nullopt;
+            }
+            if (chain.num_biquads_ == MAX_BIQUADS) {
+                error = "more than " + std::to_string(MAX_BIQUADS) + " biquad sections";
+                return std::nullopt;
+            }
+            std::optional<Biquad> section;
+            if (name == "biquad" && args.size() == 5)
+                section = Biquad{args[0], args[1], args[2], args[3], args[4]};
+            else if (name != "biquad" && args.size() == 3)
+                section = design(name, args[0], args[1], args[2]);
+            if (!section) {
+                error = "invalid arguments in '" + std::string(stage) + "'";
+                return std::nullopt;
+            }
+            chain.sections_[chain.num_biquads_++] = *section;
+        } else if (name == "fir") {
+            if (chain.num_taps_ > 0 || args.empty() || args.size() > MAX_FIR_TAPS) {
+                error = "one fir stage with 1 to " + std::to_string(MAX_FIR_TAPS) + " taps is allowed";
+                return std::nullopt;
+            }
+            std::copy(args.begin(), args.end(), chain.taps_.begin());
+            chain.num_taps_ = args.size();
+        } else {
+            error = "unknown stage '" + std::string(name) + "'";
+            return std::nullopt;
+        }
+    }
+
+    return chain;
+}
+
+void FilterChain::prime(double x) {
+    for (size_t i = 0; i < num_biquads_; i++) {
+        const Biquad& s = sections_[i];
+        auto& z = state_[i];
+        // a section with a pole at DC has no steady state, it starts from rest instead
+        double den = 1.0 + s.a1 + s.a2;
+        if (std::abs(den) < 1e-12) {
+            z = {0.0, 0.0};
+            x = 0.0;
+            continue;
+        }
+        double y = x * (s.b0 + s.b1 + s.b2) / den;
+        z[1] = s.b2 * x - s.a2 * y;
+        z[0] = s.b1 * x - s.a1 * y + z[1];
+        x = y;
+    }
+    delay_.fill(x);
+    fir_pos_ = 0;
+    primed_ = true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+inline constexpr size_t MAX_BIQUADS = 8;   ///< Largest number of biquad sections in a filter chain.
+inline constexpr size_t MAX_FIR_TAPS = 64; ///< Largest number of FIR taps in a filter chain.
+
+/// @brief A cascade of biquad sections followed by an optional FIR filter.
+///
+/// Coefficients and state live in fixed-size arrays, so processing a sample never allocates
+/// and costs one pass over the configured sections and taps. The sections use the transposed
+/// direct form II, the FIR a doubled delay line so the dot product needs no wrap-around.
+///
+/// A chain is built from a text spec of stages separated by ';', applied in that order:
+///
+///     biquad b0 b1 b2 a1 a2     raw section, a0 normalised to 1
+///     lowpass fc Q fs           2nd order low pass at fc Hz for sample rate fs Hz
+///     notch f0 Q fs             notch at f0 Hz for sample rate fs Hz
+///     fir h0 h1 ... hn          FIR taps, at most one fir stage, after all sections
+///
+/// e.g. "lowpass 20 0.707 100; notch 12.5 5 100"
+///
+/// The first sample after parse() or reset() sets the state as if the input had always had
+/// that value, so a new chain starts at the current position instead of ringing up from 0.
+class FilterChain {
+  public:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    /// @brief Builds a chain from a spec, see the class description.
+    ///
+    /// @param spec The spec, an empty spec gives a pass-through chain.
+    /// @param error Set to a description of the problem if the spec is invalid.
+    /// @return The chain, primed by the first sample, std::nullopt if the spec is invalid.
+    static std::optional<FilterChain> parse(std::string_view spec, std::string& error);
+
+    /// @brief Filters one sample.
+    double process(double x) {
+        if (!primed_)
+            prime(x);
+        for (size_t i = 0; i < num_biquads_; i++) {
+            const Biquad& s = sections_[i];
+            auto& z = state_[i];
+            double y = s.b0 * x + z[0];
+            z[0] = s.b1 * x - s.a1 * y + z[1];
+            z[1] = s.b2 * x - s.a2 * y;
+            x = y;
+        }
+        if (num_taps_ > 0) {
+            fir_pos_ = fir_pos_ == 0 ? num_taps_ - 1 : fir_pos_ - 1;
+            delay_[fir_pos_] = x;
+            delay_[fir_pos_ + num_taps_] = x;
+            const double* d = &delay_[fir_pos_];
+            double y = 0.0;
+            for (size_t k = 0; k < num_taps_; k++)
+                y += taps_[k] * d[k];
+            x = y;
+        }
+        return x;
+    }
+
+    /// @brief Clears the filter state, keeping the coefficients; the next sample primes it.
+    void reset() { primed_ = false; }
+
+    bool empty() const { return num_biquads_ == 0 && num_taps_ == 0; }
+
+  private:
+    /// @brief Sets the state to the steady state for a constant input x.
+    void prime(double x);
+
+    bool primed_ = false;
+    std::array<Biquad, MAX_BIQUADS> sections_{};
+    std::array<std::array<double, 2>, MAX_BIQUADS> state_{};
+    size_t num_biquads_ = 0;
+
+    std::array<double, MAX_FIR_TAPS> taps_{};
+    std::array<double, 2 * MAX_FIR_TAPS> delay_{};
+    size_t num_taps_ = 0;
+    size_t fir_pos_ = 0;
+};
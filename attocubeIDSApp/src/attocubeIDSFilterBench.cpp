@@ -0,0 +1,90 @@
+// Benchmark of FilterChain::process, the per-axis filter the poll cycle runs on every sample.
+//
+// Usage: attocubeIDSFilterBench [-n samples] [spec]
+//
+// Without a spec a set of chains from a single section to the largest chain allowed is
+// measured, with a spec only that chain. For each the time per sample (min, median, 99th
+// percentile and max over batches of BATCH samples) is printed.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "attocubeIDSFilter.hpp"
+
+static constexpr int BATCH = 1000;
+
+static std::string fir_spec(size_t taps) {
+    std::string spec = "fir";
+    for (size_t i = 0; i < taps; i++)
+        spec += " " + std::to_string(1.0 / taps);
+    return spec;
+}
+
+static std::string biquads_spec(size_t sections) {
+    std::string spec;
+    for (size_t i = 0; i < sections; i++)
+        spec += (i % 2 ? "notch 12.5 5 100; " : "lowpass 20 0.707 100; ");
+    return spec;
+}
+
+// Filters samples samples of a slowly moving position and prints the statistics
+static void measure(const char* name, const std::string& spec, int samples) {
+    std::string error;
+    auto chain = FilterChain::parse(spec, error);
+    if (!chain) {
+        printf("%-16s %s\n", name, error.c_str());
+        return;
+    }
+
+    std::vector<double> batch_ns;
+    batch_ns.reserve(samples / BATCH);
+    volatile double sink = 0.0;
+    double x = 0.0;
+    for (int done = 0; done + BATCH <= samples; done += BATCH) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BATCH; i++) {
+            x += 1e-6;
+            sink = chain->process(x);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        batch_ns.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / BATCH);
+    }
+    (void)sink;
+
+    std::sort(batch_ns.begin(), batch_ns.end());
+    size_t n = batch_ns.size();
+    printf("%-16s %8.1f %8.1f %8.1f %8.1f\n", name, batch_ns.front(), batch_ns[n / 2], batch_ns[n * 99 / 100],
+           batch_ns.back());
+}
+
+int main(int argc, char* argv[]) {
+    int samples = 1000000;
+    int arg = 1;
+    if (arg + 1 < argc && std::strcmp(argv[arg], "-n") == 0) {
+        samples = std::atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if (samples < BATCH) {
+        fprintf(stderr, "usage: %s [-n samples >= %d] [spec]\n", argv[0], BATCH);
+        return 1;
+    }
+
+    printf("%d samples, ns per sample\n", samples);
+    printf("%-16s %8s %8s %8s %8s\n", "", "min", "med", "p99", "max");
+    if (arg < argc) {
+        measure("spec", argv[arg], samples);
+        return 0;
+    }
+    measure("1 biquad", biquads_spec(1), samples);
+    measure("2 biquads", biquads_spec(2), samples);
+    measure("8 biquads", biquads_spec(MAX_BIQUADS), samples);
+    measure("fir 16", fir_spec(16), samples);
+    measure("fir 64", fir_spec(MAX_FIR_TAPS), samples);
+    measure("8 biquads+fir 64", biquads_spec(MAX_BIQUADS) + fir_spec(MAX_FIR_TAPS), samples);
+    return 0;
+}
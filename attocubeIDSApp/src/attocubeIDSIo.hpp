@@ -0,0 +1,107 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <asynDriver.h>
+
+class NativeConnection;
+
+inline constexpr size_t IO_BUFFER_SIZE = 512; ///< Size of the request and reply buffers of an IoContext.
+
+/// @brief Everything one request/reply exchange with the controller needs.
+///
+/// Each context has its own asynUser and buffers, so threads holding different contexts can
+/// talk to the controller at the same time without sharing any mutable state. The asyn port
+/// or native connection underneath serialises the exchanges on the wire.
+struct IoContext {
+    asynUser* pasynUser = nullptr;            ///< This context's connection to the asyn IP port.
+    NativeConnection* native = nullptr;       ///< The connection to use instead, if native.
+    std::array<char, IO_BUFFER_SIZE> out{};   ///< Request sent to the device.
+    std::array<char, IO_BUFFER_SIZE> in{};    ///< Reply received from the device.
+    size_t nbytesout = 0;                     ///< Bytes sent by the last exchange.
+    size_t nbytesin = 0;                      ///< Bytes received by the last exchange.
+    int eom_reason = 0;                       ///< End of message reason of the last read.
+};
+
+/// @brief A fixed set of IoContexts handed out one request at a time.
+///
+/// All contexts are allocated up front. acquire() takes a free one and waits if all are in
+/// use; the Lease returns it to the pool when it goes out of scope.
+class IoContextPool {
+  public:
+    class Lease {
+      public:
+        Lease(IoContextPool& pool, IoContext& io) : pool_(&pool), io_(&io) {}
+        Lease(Lease&& other) noexcept : pool_(other.pool_), io_(other.io_) { other.pool_ = nullptr; }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease() {
+            if (pool_)
+                pool_->release(*io_);
+        }
+
+        IoContext& operator*() const { return *io_; }
+        IoContext* operator->() const { return io_; }
+
+      private:
+        IoContextPool* pool_;
+        IoContext* io_;
+    };
+
+    explicit IoContextPool(size_t size) : contexts_(size) {
+        free_.reserve(size);
+        for (auto& io : contexts_)
+            free_.push_back(&io);
+    }
+
+    /// @brief Takes a free context, waiting until one is returned if necessary.
+    Lease acquire() {
+        std::unique_lock<std::mutex> guard(mutex_);
+        if (free_.empty()) {
+            waits_++;
+            available_.wait(guard, [this] { return !free_.empty(); });
+        }
+        IoContext* io = free_.back();
+        free_.pop_back();
+        peak_in_use_ = std::max(peak_in_use_, contexts_.size() - free_.size());
+        return Lease(*this, *io);
+    }
+
+    /// @brief All contexts, for connecting them. Not to be used for I/O.
+    std::vector<IoContext>& contexts() { return contexts_; }
+
+    size_t size() const { return contexts_.size(); }
+
+    /// @brief Most contexts in use at the same time so far.
+    size_t peak_in_use() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return peak_in_use_;
+    }
+
+    /// @brief Number of acquire() calls that had to wait for a context.
+    size_t waits() const {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return waits_;
+    }
+
+  private:
+    void release(IoContext& io) {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            free_.push_back(&io);
+        }
+        available_.notify_one();
+    }
+
+    std::vector<IoContext> contexts_;
+    std::vector<IoContext*> free_;
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    size_t peak_in_use_ = 0;
+    size_t waits_ = 0;
+};
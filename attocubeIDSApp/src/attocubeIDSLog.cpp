@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+
+#include <epicsExit.h>
+#include <epicsThread.h>
+#include <errlog.h>
+
+#include "attocubeIDSLog.hpp"
+
+static constexpr double LOG_DRAIN_PERIOD = 0.05; ///< Seconds the log thread sleeps when the queue is empty.
+
+static const char* const LOG_CLASS_NAMES[NUM_LOG_CLASSES] = {"transport", "protocol", "internal"};
+
+static int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+Logger& Logger::shared() {
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+Logger::Logger() : cells_(new Cell[LOG_QUEUE_SIZE]) {
+    static_assert((LOG_QUEUE_SIZE & (LOG_QUEUE_SIZE - 1)) == 0, "LOG_QUEUE_SIZE must be a power of 2");
+    for (size_t i = 0; i < LOG_QUEUE_SIZE; i++)
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+    set_limit(DEFAULT_LOG_RATE, DEFAULT_LOG_BURST);
+    epicsTimeGetCurrent(&last_summary_);
+    // the logger lives as long as the IOC, so does its thread
+    epicsThreadCreate(
+        "AttocubeIDSLog", epicsThreadPriorityLow, epicsThreadGetStackSize(epicsThreadStackSmall),
+        [](void* logger) { static_cast<Logger*>(logger)->run(); }, this);
+    // the ports create the logger before registering their stop(), so this runs after them
+    epicsAtExit([](void* logger) { static_cast<Logger*>(logger)->flush(); }, this);
+}
+
+void Logger::set_limit(double rate, double burst) {
+    int64_t interval = rate > 0.0 ? static_cast<int64_t>(1e9 / rate) : 0;
+    interval_ns_.store(interval, std::memory_order_relaxed);
+    tolerance_ns_.store(static_cast<int64_t>(std::max(burst, 1.0) * interval), std::memory_order_relaxed);
+}
+
+void Logger::log(LogClass cls, const char* source, const char* fmt, ...) {
+    // claim a slot, the bounded queue of D. Vyukov
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells_[pos & (LOG_QUEUE_SIZE - 1)];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    Entry& entry = cell->entry;
+    entry.cls = cls;
+    entry.source = source;
+    epicsTimeGetCurrent(&entry.time);
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(entry.text, sizeof(entry.text), fmt, args);
+    va_end(args);
+    // strip the newline asynPrint-style messages end with, print() adds it
+    size_t len = strlen(entry.text);
+    if (len && entry.text[len - 1] == '\n')
+        entry.text[len - 1] = '\0';
+
+    cell->seq.store(pos + 1, std::memory_order_release);
+    logged_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Logger::pop(Entry& entry) {
+    Cell& cell = cells_[head_ & (LOG_QUEUE_SIZE - 1)];
+    if (cell.seq.load(std::memory_order_acquire) != head_ + 1)
+        return false;
+    entry = cell.entry;
+    cell.seq.store(head_ + LOG_QUEUE_SIZE, std::memory_order_release);
+    head_++;
+    return true;
+}
+
+void Logger::print(const Entry& entry, const char* text) const {
+    char time[40];
+    epicsTimeToStrftime(time, sizeof(time), "%Y/%m/%d %H:%M:%S.%03f", &entry.time);
+    errlogPrintf("%s %s %s: %s\n", time, entry.source ? entry.source : "AttocubeIDS",
+                 LOG_CLASS_NAMES[static_cast<size_t>(entry.cls)], text);
+}
+
+bool Logger::admit(LogClass cls) {
+    int64_t interval = interval_ns_.load(std::memory_order_relaxed);
+    if (interval == 0)
+        return true;
+    int64_t now = steady_ns();
+    int64_t& arrival = arrival_ns_[static_cast<size_t>(cls)];
+    // the bucket is empty when the next message would arrive further ahead than the burst allows
+    int64_t next = std::max(arrival, now) + interval;
+    if (next - now > tolerance_ns_.load(std::memory_order_relaxed))
+        return false;
+    arrival = next;
+    return true;
+}
+
+void Logger::handle(const Entry& entry) {
+    for (Recent& recent : recent_) {
+        if (recent.used && recent.entry.cls == entry.cls && recent.entry.source == entry.source &&
+            !strcmp(recent.entry.text, entry.text)) {
+            if (recent.repeats++ == 0)
+                recent.since = entry.time;
+            folded_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    if (!admit(entry.cls)) {
+        suppressed_[static_cast<size_t>(entry.cls)].fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    print(entry, entry.text);
+    printed_.fetch_add(1, std::memory_order_relaxed);
+
+    Recent& oldest = recent_[recent_next_];
+    recent_next_ = (recent_next_ + 1) % recent_.size();
+    summarise_repeats(oldest);
+    oldest.used = true;
+    oldest.entry = entry;
+}
+
+void Logger::summarise_repeats(Recent& recent) {
+    if (recent.repeats == 0)
+        return;
+    char text[LOG_MESSAGE_SIZE + 40];
+    snprintf(text, sizeof(text), "\"%s\" repeated %llu times", recent.entry.text,
+             static_cast<unsigned long long>(recent.repeats));
+    Entry summary = recent.entry;
+    epicsTimeGetCurrent(&summary.time);
+    print(summary, text);
+    printed_.fetch_add(1, std::memory_order_relaxed);
+    recent.repeats = 0;
+}
+
+void Logger::summarise_suppressed() {
+    for (size_t c = 0; c < NUM_LOG_CLASSES; c++) {
+        uint64_t suppressed = suppressed_[c].load(std::memory_order_relaxed);
+        if (suppressed != suppressed_reported_[c]) {
+            errlogPrintf("AttocubeIDS: %llu %s messages suppressed by the rate limit\n",
+                         static_cast<unsigned long long>(suppressed - suppressed_reported_[c]), LOG_CLASS_NAMES[c]);
+            suppressed_reported_[c] = suppressed;
+        }
+    }
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != dropped_reported_) {
+        errlogPrintf("AttocubeIDS: %llu messages dropped, the log queue was full\n",
+                     static_cast<unsigned long long>(dropped - dropped_reported_));
+        dropped_reported_ = dropped;
+    }
+}
+
+void Logger::drain() {
+    Entry entry;
+    while (pop(entry))
+        handle(entry);
+
+    epicsTimeStamp now;
+    epicsTimeGetCurrent(&now);
+    for (Recent& recent : recent_) {
+        if (recent.repeats && epicsTimeDiffInSeconds(&now, &recent.since) >= LOG_REPEAT_SUMMARY_PERIOD)
+            summarise_repeats(recent);
+    }
+    if (epicsTimeDiffInSeconds(&now, &last_summary_) >= LOG_REPEAT_SUMMARY_PERIOD) {
+        summarise_suppressed();
+        last_summary_ = now;
+    }
+}
+
+void Logger::run() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> guard(drain_mutex_);
+            drain();
+        }
+        epicsThreadSleep(LOG_DRAIN_PERIOD);
+    }
+}
+
+void Logger::flush() {
+    std::lock_guard<std::mutex> guard(drain_mutex_);
+    drain();
+    for (Recent& recent : recent_)
+        summarise_repeats(recent);
+    summarise_suppressed();
+    errlogFlush();
+}
+
+void Logger::report(FILE* fp) const {
+    fprintf(fp, "AttocubeIDS log: %llu queued, %llu printed, %llu folded into repeats, %llu dropped\n",
+            static_cast<unsigned long long>(logged_.load()), static_cast<unsigned long long>(printed_.load()),
+            static_cast<unsigned long long>(folded_.load()), static_cast<unsigned long long>(dropped_.load()));
+    for (size_t c = 0; c < NUM_LOG_CLASSES; c++)
+        fprintf(fp, "  %s: %llu suppressed\n", LOG_CLASS_NAMES[c],
+                static_cast<unsigned long long>(suppressed_[c].load()));
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+#include <epicsTime.h>
+
+/// @brief What a message is about, each class is rate limited on its own.
+enum class LogClass : uint8_t {
+    Transport, ///< Requests that could not be sent or got no reply.
+    Protocol,  ///< Requests or replies that could not be encoded or decoded.
+    Internal,  ///< Problems of the driver's own threads.
+};
+inline constexpr size_t NUM_LOG_CLASSES = static_cast<size_t>(LogClass::Internal) + 1;
+
+inline constexpr size_t LOG_QUEUE_SIZE = 256;           ///< Messages waiting to be printed, a power of 2.
+inline constexpr size_t LOG_MESSAGE_SIZE = 160;         ///< Longer messages are truncated.
+inline constexpr double DEFAULT_LOG_RATE = 5.0;         ///< Messages per second and class.
+inline constexpr double DEFAULT_LOG_BURST = 20.0;       ///< Messages per class that may come at once.
+inline constexpr double LOG_REPEAT_SUMMARY_PERIOD = 10.0; ///< Seconds between "repeated" summaries.
+inline constexpr size_t LOG_RECENT_MESSAGES = 8;        ///< Distinct messages remembered for folding repeats.
+
+/// @brief Error messages from the acquisition threads, printed by a thread of its own.
+///
+/// log() formats the message into a slot of a bounded lock-free queue and returns, the
+/// console I/O happens on the "AttocubeIDSLog" thread. A message equal to one of the last
+/// few printed is only counted and summarised as "repeated N times"; the others go through
+/// a token bucket per LogClass, so an outage prints a few lines rather than one per failed
+/// request. Messages over the limit or that find the queue full are counted and reported
+/// as suppressed.
+class Logger {
+  public:
+    /// @brief The logger shared by all ports, started on first use.
+    static Logger& shared();
+
+    /// @brief Queues a message, never blocks.
+    ///
+    /// @param source Printed before the message, usually the asyn port name. Must outlive
+    /// the logger.
+    void log(LogClass cls, const char* source, const char* fmt, ...) __attribute__((format(printf, 4, 5)));
+
+    /// @brief Sets the token bucket of every class, rate 0 disables the limit.
+    void set_limit(double rate, double burst);
+
+    /// @brief Prints the queued messages and pending summaries now, called at IOC exit.
+    void flush();
+
+    /// @brief Prints the message counts.
+    void report(FILE* fp) const;
+
+  private:
+    struct Entry {
+        LogClass cls;
+        const char* source;
+        epicsTimeStamp time;
+        char text[LOG_MESSAGE_SIZE];
+    };
+
+    /// @brief A queue slot, seq tells producers and the consumer whose turn it is.
+    struct Cell {
+        std::atomic<size_t> seq;
+        Entry entry;
+    };
+
+    /// @brief A message printed lately and how often it came again since.
+    struct Recent {
+        bool used = false;
+        Entry entry;
+        uint64_t repeats = 0;
+        epicsTimeStamp since;
+    };
+
+    Logger();
+    void run();
+    void drain();
+    bool pop(Entry& entry);
+    void handle(const Entry& entry);
+    bool admit(LogClass cls);
+    void print(const Entry& entry, const char* text) const;
+    void summarise_repeats(Recent& recent);
+    void summarise_suppressed();
+
+    std::unique_ptr<Cell[]> cells_;
+    std::atomic<size_t> tail_{0}; ///< Next slot to claim by producers.
+    size_t head_ = 0;             ///< Next slot to print, only used by the log thread.
+
+    std::atomic<int64_t> interval_ns_;  ///< Token bucket refill interval, 0 for no limit.
+    std::atomic<int64_t> tolerance_ns_; ///< Burst size times interval_ns_.
+    std::array<std::atomic<uint64_t>, NUM_LOG_CLASSES> suppressed_{};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> logged_{0};
+
+    // only used by the log thread, or by flush() while holding drain_mutex_
+    std::mutex drain_mutex_;
+    epicsTimeStamp last_summary_;
+    std::array<int64_t, NUM_LOG_CLASSES> arrival_ns_{}; ///< Token buckets as theoretical arrival times.
+    std::array<Recent, LOG_RECENT_MESSAGES> recent_;
+    size_t recent_next_ = 0; ///< The slot of recent_ to reuse next.
+    std::array<uint64_t, NUM_LOG_CLASSES> suppressed_reported_{};
+    uint64_t dropped_reported_ = 0;
+    std::atomic<uint64_t> printed_{0};
+    std::atomic<uint64_t> folded_{0};
+};
@@ -0,0 +1,106 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "attocubeIDSMcast.hpp"
+
+std::unique_ptr<McastPublisher> McastPublisher::create(const std::string& group, int port,
+                                                       int samples_per_packet, int ttl, const std::string& iface,
+                                                       std::string& error) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (port <= 0 || port > 65535 || inet_pton(AF_INET, group.c_str(), &addr.sin_addr) != 1 ||
+        !IN_MULTICAST(ntohl(addr.sin_addr.s_addr))) {
+        error = "invalid multicast group or port";
+        return nullptr;
+    }
+    if (samples_per_packet < 1 || samples_per_packet > IDS_MCAST_MAX_SAMPLES) {
+        error = "samples per packet must be 1 to " + std::to_string(IDS_MCAST_MAX_SAMPLES);
+        return nullptr;
+    }
+
+    std::unique_ptr<McastPublisher> pub(new McastPublisher);
+    pub->fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (pub->fd_ < 0) {
+        error = std::string("socket: ") + strerror(errno);
+        return nullptr;
+    }
+
+    unsigned char mttl = ttl < 0 ? 0 : ttl > 255 ? 255 : ttl;
+    unsigned char loop = 1;
+    setsockopt(pub->fd_, IPPROTO_IP, IP_MULTICAST_TTL, &mttl, sizeof(mttl));
+    setsockopt(pub->fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    if (!iface.empty()) {
+        in_addr if_addr{};
+        if (inet_pton(AF_INET, iface.c_str(), &if_addr) != 1 ||
+            setsockopt(pub->fd_, IPPROTO_IP, IP_MULTICAST_IF, &if_addr, sizeof(if_addr)) != 0) {
+            error = "invalid interface address " + iface;
+            return nullptr;
+        }
+    }
+
+    pub->addr_ = addr;
+    pub->destination_ = group + ":" + std::to_string(port);
+    pub->samples_per_packet_ = samples_per_packet;
+    // differs from the session of an earlier stream, whose sequence numbers also started at 0
+    auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+                   .count();
+    pub->session_ = static_cast<uint32_t>(now ^ (now >> 32));
+    if (pub->session_ == 0)
+        pub->session_ = 1;
+    return pub;
+}
+
+McastPublisher::~McastPublisher() {
+    if (fd_ >= 0)
+        close(fd_);
+}
+
+void McastPublisher::add(int64_t realtime_ns, uint32_t valid_mask,
+                         const std::array<int64_t, IDS_MCAST_AXES>& displacement_pm) {
+    if (num_samples_ > 0 && valid_mask != valid_mask_)
+        flush();
+    valid_mask_ = valid_mask;
+
+    idsMcastSample sample;
+    sample.realtime_ns = realtime_ns;
+    for (size_t i = 0; i < IDS_MCAST_AXES; i++)
+        sample.displacement_pm[i] = displacement_pm[i];
+    idsMcastEncodeSample(&packet_[IDS_MCAST_HEADER_SIZE + num_samples_ * IDS_MCAST_SAMPLE_SIZE], &sample);
+
+    if (++num_samples_ == samples_per_packet_)
+        flush();
+}
+
+void McastPublisher::flush() {
+    if (num_samples_ == 0)
+        return;
+
+    idsMcastHeader header;
+    header.magic = IDS_MCAST_MAGIC;
+    header.version = IDS_MCAST_VERSION;
+    header.num_axes = IDS_MCAST_AXES;
+    header.num_samples = num_samples_;
+    header.session = session_;
+    header.valid_mask = valid_mask_;
+    header.packet_seq = packet_seq_++;
+    header.first_sample_seq = sample_seq_;
+    idsMcastEncodeHeader(packet_.data(), &header);
+
+    size_t len = IDS_MCAST_HEADER_SIZE + num_samples_ * IDS_MCAST_SAMPLE_SIZE;
+    sample_seq_ += num_samples_;
+    num_samples_ = 0;
+
+    ssize_t sent = sendto(fd_, packet_.data(), len, MSG_DONTWAIT, reinterpret_cast<const sockaddr*>(&addr_),
+                          sizeof(addr_));
+    if (sent == static_cast<ssize_t>(len))
+        packets_sent_++;
+    else
+        packets_dropped_++;
+}
@@ -0,0 +1,128 @@
+#ifndef ATTOCUBE_IDS_MCAST_H
+#define ATTOCUBE_IDS_MCAST_H
+
+/*
+ * Wire format of the UDP multicast displacement stream published by the AttocubeIDS driver
+ * (see AttocubeIDSMcast in the iocsh).
+ *
+ * Each datagram is a header followed by num_samples samples, all integers big-endian:
+ *
+ *     offset  size  field
+ *          0     4  magic              IDS_MCAST_MAGIC
+ *          4     2  version            IDS_MCAST_VERSION
+ *          6     1  num_axes           IDS_MCAST_AXES
+ *          7     1  num_samples        1 to IDS_MCAST_MAX_SAMPLES
+ *          8     4  session            chosen when the stream starts, never 0
+ *         12     4  valid_mask         bit n set if displacement_pm[n] of all samples is valid
+ *         16     8  packet_seq         +1 for every datagram, a gap means lost datagrams
+ *         24     8  first_sample_seq   sequence number of the first sample, +1 per sample
+ *         32    32  sample[0]          realtime_ns, displacement_pm[0..2], int64 each
+ *         ...
+ *
+ * Both sequence numbers start at 0 again when the IOC restarts or the stream is reconfigured,
+ * which also changes session; a receiver resynchronises on datagrams with a new session
+ * instead of taking them for old, reordered ones. The samples of a datagram share one
+ * valid_mask, a change of the axes in use starts a new datagram.
+ *
+ * The largest datagram fits a 1500 byte Ethernet MTU without fragmentation.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IDS_MCAST_MAGIC 0x4944534du /* "IDSM" */
+#define IDS_MCAST_VERSION 2u
+#define IDS_MCAST_AXES 3
+#define IDS_MCAST_HEADER_SIZE 32
+#define IDS_MCAST_SAMPLE_SIZE (8 * (1 + IDS_MCAST_AXES))
+#define IDS_MCAST_MAX_SAMPLES 45
+#define IDS_MCAST_MAX_PACKET (IDS_MCAST_HEADER_SIZE + IDS_MCAST_MAX_SAMPLES * IDS_MCAST_SAMPLE_SIZE)
+
+typedef struct idsMcastHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t num_axes;
+    uint8_t num_samples;
+    uint32_t session;
+    uint32_t valid_mask;
+    uint64_t packet_seq;
+    uint64_t first_sample_seq;
+} idsMcastHeader;
+
+typedef struct idsMcastSample {
+    int64_t realtime_ns; /* CLOCK_REALTIME when the reply arrived */
+    int64_t displacement_pm[IDS_MCAST_AXES];
+} idsMcastSample;
+
+static inline void idsMcastPut64(unsigned char* p, uint64_t v) {
+    int i;
+    for (i = 7; i >= 0; i--, v >>= 8)
+        p[i] = (unsigned char)v;
+}
+
+static inline void idsMcastPut32(unsigned char* p, uint32_t v) {
+    int i;
+    for (i = 3; i >= 0; i--, v >>= 8)
+        p[i] = (unsigned char)v;
+}
+
+static inline uint32_t idsMcastGet32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t idsMcastGet64(const unsigned char* p) {
+    uint64_t v = 0;
+    int i;
+    for (i = 0; i < 8; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline void idsMcastEncodeHeader(unsigned char* p, const idsMcastHeader* h) {
+    idsMcastPut32(p, h->magic);
+    p[4] = (unsigned char)(h->version >> 8);
+    p[5] = (unsigned char)h->version;
+    p[6] = h->num_axes;
+    p[7] = h->num_samples;
+    idsMcastPut32(p + 8, h->session);
+    idsMcastPut32(p + 12, h->valid_mask);
+    idsMcastPut64(p + 16, h->packet_seq);
+    idsMcastPut64(p + 24, h->first_sample_seq);
+}
+
+static inline void idsMcastEncodeSample(unsigned char* p, const idsMcastSample* s) {
+    int i;
+    idsMcastPut64(p, (uint64_t)s->realtime_ns);
+    for (i = 0; i < IDS_MCAST_AXES; i++)
+        idsMcastPut64(p + 8 * (i + 1), (uint64_t)s->displacement_pm[i]);
+}
+
+/* Decodes and validates the header of a datagram of len bytes, returns 0 on success */
+static inline int idsMcastDecodeHeader(const unsigned char* p, size_t len, idsMcastHeader* h) {
+    if (len < IDS_MCAST_HEADER_SIZE)
+        return -1;
+    h->magic = idsMcastGet32(p);
+    h->version = (uint16_t)((p[4] << 8) | p[5]);
+    h->num_axes = p[6];
+    h->num_samples = p[7];
+    h->session = idsMcastGet32(p + 8);
+    h->valid_mask = idsMcastGet32(p + 12);
+    h->packet_seq = idsMcastGet64(p + 16);
+    h->first_sample_seq = idsMcastGet64(p + 24);
+    if (h->magic != IDS_MCAST_MAGIC || h->version != IDS_MCAST_VERSION || h->num_axes != IDS_MCAST_AXES ||
+        h->num_samples == 0 || h->num_samples > IDS_MCAST_MAX_SAMPLES ||
+        len < IDS_MCAST_HEADER_SIZE + (size_t)h->num_samples * IDS_MCAST_SAMPLE_SIZE)
+        return -1;
+    return 0;
+}
+
+/* Decodes sample i of a datagram whose header was accepted by idsMcastDecodeHeader */
+static inline void idsMcastDecodeSample(const unsigned char* p, unsigned i, idsMcastSample* s) {
+    int k;
+    p += IDS_MCAST_HEADER_SIZE + (size_t)i * IDS_MCAST_SAMPLE_SIZE;
+    s->realtime_ns = (int64_t)idsMcastGet64(p);
+    for (k = 0; k < IDS_MCAST_AXES; k++)
+        s->displacement_pm[k] = (int64_t)idsMcastGet64(p + 8 * (k + 1));
+}
+
+#endif /* ATTOCUBE_IDS_MCAST_H */
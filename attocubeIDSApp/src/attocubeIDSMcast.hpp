@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <netinet/in.h>
+
+#include "attocubeIDSMcast.h"
+
+/// @brief Batches displacement samples into datagrams and sends them to a multicast group.
+///
+/// Sending never blocks: if the socket buffer is full the datagram is dropped and counted,
+/// receivers see the gap in packet_seq. See attocubeIDSMcast.h for the wire format.
+class McastPublisher {
+  public:
+    /// @brief Opens the socket.
+    ///
+    /// @param group Multicast group address, e.g. "239.255.10.1".
+    /// @param port UDP destination port.
+    /// @param samples_per_packet Samples batched into one datagram, 1 to IDS_MCAST_MAX_SAMPLES.
+    /// @param ttl Multicast TTL, 0 keeps the stream on this host, 1 on the local subnet.
+    /// @param iface Address of the interface to send from, empty for the default route.
+    /// @param error Set to a description of the problem on failure.
+    /// @return The publisher, nullptr on failure.
+    static std::unique_ptr<McastPublisher> create(const std::string& group, int port, int samples_per_packet,
+                                                  int ttl, const std::string& iface, std::string& error);
+    ~McastPublisher();
+
+    /// @brief Adds one sample, sends the datagram once it is full.
+    ///
+    /// @param valid_mask Bit n set if displacement_pm[n] is valid; a sample whose mask differs
+    /// from that of the samples already batched starts a new datagram.
+    void add(int64_t realtime_ns, uint32_t valid_mask,
+             const std::array<int64_t, IDS_MCAST_AXES>& displacement_pm);
+
+    /// @brief Sends a partly filled datagram, if any.
+    void flush();
+
+    const std::string& destination() const { return destination_; }
+    uint32_t session() const { return session_; }
+    uint64_t packets_sent() const { return packets_sent_; }
+    uint64_t packets_dropped() const { return packets_dropped_; }
+    size_t samples_per_packet() const { return samples_per_packet_; }
+
+  private:
+    McastPublisher() = default;
+
+    int fd_ = -1;
+    sockaddr_in addr_{}; ///< The multicast group and port.
+    std::string destination_;
+    size_t samples_per_packet_ = 1;
+
+    std::array<unsigned char, IDS_MCAST_MAX_PACKET> packet_{};
+    size_t num_samples_ = 0;
+    uint32_t valid_mask_ = 0; ///< Of the samples batched in packet_.
+    uint32_t session_ = 0;
+    uint64_t packet_seq_ = 0;
+    uint64_t sample_seq_ = 0;
+    uint64_t packets_sent_ = 0;
+    uint64_t packets_dropped_ = 0;
+};
@@ -0,0 +1,146 @@
+// Reference receiver for the AttocubeIDS multicast displacement stream.
+//
+// Usage: attocubeIDSMcastRecv [-v] group port [interface]
+//
+// Joins the group and prints once per second how many datagrams and samples arrived, how many
+// datagrams were lost or arrived out of order (from gaps in packet_seq), how often the publisher
+// restarted (a new session) and the mean age of the samples on arrival (only meaningful if the
+// clocks of both hosts are synchronised).
+// With -v every sample is printed as well, "-" for an axis that is not valid.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "attocubeIDSMcast.h"
+
+static int64_t realtime_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+int main(int argc, char* argv[]) {
+    bool verbose = false;
+    int arg = 1;
+    if (arg < argc && std::strcmp(argv[arg], "-v") == 0) {
+        verbose = true;
+        arg++;
+    }
+    if (argc - arg < 2) {
+        fprintf(stderr, "usage: %s [-v] group port [interface]\n", argv[0]);
+        return 1;
+    }
+    const char* group = argv[arg];
+    int port = std::atoi(argv[arg + 1]);
+    const char* iface = argc - arg > 2 ? argv[arg + 2] : "0.0.0.0";
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        perror("bind");
+        return 1;
+    }
+
+    ip_mreq mreq{};
+    if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1 || inet_pton(AF_INET, iface, &mreq.imr_interface) != 1) {
+        fprintf(stderr, "invalid group or interface address\n");
+        return 1;
+    }
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0) {
+        perror("IP_ADD_MEMBERSHIP");
+        return 1;
+    }
+
+    timeval timeout{1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    bool primed = false;
+    uint32_t session = 0;
+    uint64_t expected_seq = 0;
+    uint64_t packets = 0, samples = 0, lost = 0, late = 0, invalid = 0, restarts = 0;
+    uint64_t total_packets = 0, total_lost = 0;
+    double age_sum = 0.0;
+    auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    unsigned char buf[IDS_MCAST_MAX_PACKET + 1];
+
+    while (true) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        int64_t now_ns = realtime_ns();
+
+        idsMcastHeader header;
+        if (len > 0 && idsMcastDecodeHeader(buf, len, &header) != 0) {
+            invalid++;
+        } else if (len > 0) {
+            // a new session numbers its datagrams from 0 again, the counting starts over
+            if (primed && header.session != session)
+                restarts++;
+            if (!primed || header.session != session || header.packet_seq == expected_seq) {
+                expected_seq = header.packet_seq + 1;
+            } else if (header.packet_seq > expected_seq) {
+                lost += header.packet_seq - expected_seq;
+                expected_seq = header.packet_seq + 1;
+            } else {
+                // older than one already seen: reordered or duplicated
+                late++;
+            }
+            primed = true;
+            session = header.session;
+            packets++;
+
+            for (unsigned i = 0; i < header.num_samples; i++) {
+                idsMcastSample sample;
+                idsMcastDecodeSample(buf, i, &sample);
+                age_sum += (now_ns - sample.realtime_ns) * 1e-9;
+                if (verbose) {
+                    printf("%llu %lld.%09lld", static_cast<unsigned long long>(header.first_sample_seq + i),
+                           static_cast<long long>(sample.realtime_ns / 1000000000),
+                           static_cast<long long>(sample.realtime_ns % 1000000000));
+                    for (int axis = 0; axis < IDS_MCAST_AXES; axis++) {
+                        if (header.valid_mask & (1u << axis))
+                            printf(" %lld", static_cast<long long>(sample.displacement_pm[axis]));
+                        else
+                            printf(" -");
+                    }
+                    printf("\n");
+                }
+            }
+            samples += header.num_samples;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_report) {
+            total_packets += packets;
+            total_lost += lost;
+            fprintf(stderr,
+                    "packets %llu samples %llu lost %llu late %llu invalid %llu restarts %llu "
+                    "mean age %.3f ms, total lost %llu of %llu\n",
+                    static_cast<unsigned long long>(packets), static_cast<unsigned long long>(samples),
+                    static_cast<unsigned long long>(lost), static_cast<unsigned long long>(late),
+                    static_cast<unsigned long long>(invalid), static_cast<unsigned long long>(restarts),
+                    samples ? 1e3 * age_sum / samples : 0.0,
+                    static_cast<unsigned long long>(total_lost),
+                    static_cast<unsigned long long>(total_packets + total_lost));
+            packets = samples = lost = late = invalid = restarts = 0;
+            age_sum = 0.0;
+            next_report = now + std::chrono::seconds(1);
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief How samples acquired between two publications are reduced to the published value.
+enum class PublishMode {
+    Latest = 0,   ///< The newest sample.
+    Average = 1,  ///< The mean of the samples since the last publication.
+    Decimate = 2, ///< The newest of every n-th sample, so published samples are evenly spaced.
+};
+
+/// @brief Collects the fast-changing values of each poll cycle until they are published.
+///
+/// The poller adds one sample per param and cycle, the publisher takes the reduced value of
+/// each param that got samples since it last looked. Params are registered once, after that
+/// nothing is allocated. Not thread-safe, both sides hold the driver lock.
+class PublishAccumulator {
+  public:
+    /// @brief Makes a param accumulate, must be called before add() is used on it.
+    void add_param(int param, bool integer) {
+        if (param < 0)
+            return;
+        if (static_cast<size_t>(param) >= slot_of_param_.size())
+            slot_of_param_.resize(param + 1, -1);
+        slot_of_param_[param] = entries_.size();
+        entries_.push_back(Entry{param, integer});
+    }
+
+    /// @brief Adds the sample of this cycle.
+    void add(int param, double value) {
+        Entry& e = entries_[slot_of_param_[param]];
+        // summing offsets from the first sample keeps picometre positions exact in a double
+        if (e.count == 0)
+            e.base = value;
+        e.latest = value;
+        e.sum += value - e.base;
+        e.count++;
+        e.fresh = true;
+    }
+
+    /// @brief Marks the end of a poll cycle, for decimation.
+    ///
+    /// @return true if this cycle's samples are the decimated ones.
+    bool end_cycle() {
+        bool kept = ++cycle_ % decimation_ == 0;
+        if (kept) {
+            for (Entry& e : entries_) {
+                if (e.fresh) {
+                    e.decimated = e.latest;
+                    e.decimated_fresh = true;
+                }
+            }
+        }
+        for (Entry& e : entries_)
+            e.fresh = false;
+        return kept;
+    }
+
+    /// @brief Sets how many cycles make one decimated sample.
+    void set_decimation(size_t n) { decimation_ = n > 0 ? n : 1; }
+
+    /// @brief Forgets everything accumulated, e.g. after the mode changed.
+    void reset() {
+        for (Entry& e : entries_) {
+            e.sum = 0.0;
+            e.count = 0;
+            e.fresh = false;
+            e.decimated_fresh = false;
+        }
+        cycle_ = 0;
+    }
+
+    /// @brief Calls set(param, integer, value) for every param with a value to publish in this
+    /// mode, and starts a new accumulation.
+    template <typename Set>
+    void take(PublishMode mode, Set&& set) {
+        for (Entry& e : entries_) {
+            switch (mode) {
+            case PublishMode::Latest:
+                if (e.count > 0)
+                    set(e.param, e.integer, e.latest);
+                break;
+            case PublishMode::Average:
+                if (e.count > 0)
+                    set(e.param, e.integer, e.base + e.sum / e.count);
+                break;
+            case PublishMode::Decimate:
+                if (e.decimated_fresh)
+                    set(e.param, e.integer, e.decimated);
+                break;
+            }
+            e.sum = 0.0;
+            e.count = 0;
+            e.decimated_fresh = false;
+        }
+    }
+
+    /// @brief Rounds an accumulated value for an integer param.
+    static int64_t to_integer(double value) { return std::llround(value); }
+
+  private:
+    struct Entry {
+        int param;
+        bool integer;
+        double latest = 0.0;
+        double base = 0.0;
+        double sum = 0.0;
+        size_t count = 0;
+        bool fresh = false; ///< Got a sample in the current cycle.
+        double decimated = 0.0;
+        bool decimated_fresh = false;
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<int> slot_of_param_;
+    size_t decimation_ = 1;
+    size_t cycle_ = 0;
+};
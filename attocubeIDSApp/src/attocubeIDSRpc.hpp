@@ -0,0 +1,580 @@
+#pragma once
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+/// @brief Compile-time description of an IDS JSON-RPC method.
+///
+/// Each method in the Method namespace derives from Rpc and adds a `name`. The result layout
+/// mirrors the positional "result" array sent by the controller, the parameter list mirrors
+/// the positional "params" array. Both are used to generate the encoder and decoder.
+///
+/// @tparam Result std::tuple or std::array describing the "result" array.
+/// @tparam Params Types of the positional parameters the method takes.
+template <typename Result, typename... Params>
+struct Rpc {
+    using result_type = Result;
+    using params_type = std::tuple<Params...>;
+};
+
+namespace RpcCodec {
+/// @brief A JSON string result decoded as a view into the reply buffer.
+///
+/// Nothing is copied or unescaped while decoding. The view is only valid while the reply
+/// buffer is, so results holding a JsonString must be used inside the visitor passed to
+/// AttocubeIDS::visit_rpc.
+struct JsonString {
+    std::string_view raw; ///< The characters between the quotes, escape sequences unresolved.
+    bool escaped = false; ///< Whether raw contains escape sequences.
+
+    /// @brief Compares the unescaped string with s without allocating.
+    bool equals(std::string_view s) const;
+
+    /// @brief Unescapes the string into out, reusing its capacity.
+    bool assign_to(std::string& out) const;
+};
+
+/// @brief Why an RPC failed, in the order of the exchange.
+enum class RpcError : uint8_t {
+    None,      ///< Success.
+    Timeout,   ///< No reply within IO_TIMEOUT.
+    Transport, ///< The request could not be sent or the connection failed.
+    Framing,   ///< The reply did not end with the terminator, e.g. longer than the buffer.
+    Parse,     ///< The reply is not a JSON-RPC response.
+    Type,      ///< The result does not have the layout the method declares.
+    Remote,    ///< The controller answered with a JSON-RPC error object.
+};
+inline constexpr size_t NUM_RPC_ERRORS = static_cast<size_t>(RpcError::Remote) + 1;
+
+/// @brief The JSON-RPC error object of a reply.
+struct RemoteError {
+    int64_t code = 0;
+    JsonString message; ///< Views the reply buffer.
+};
+} // namespace RpcCodec
+
+namespace Method {
+struct AxisDisplacement : Rpc<std::tuple<int, int64_t>, int> {
+    static constexpr std::string_view name = "com.attocube.ids.displacement.getAxisDisplacement";
+};
+struct AxesDisplacement : Rpc<std::tuple<int, int64_t, int64_t, int64_t>> {
+    static constexpr std::string_view name = "com.attocube.ids.displacement.getAxesDisplacement";
+};
+struct AbsolutePosition : Rpc<std::tuple<int, int64_t>, int> {
+    static constexpr std::string_view name = "com.attocube.ids.displacement.getAbsolutePosition";
+};
+struct AbsolutePositions : Rpc<std::tuple<int, int64_t, int64_t, int64_t>> {
+    static constexpr std::string_view name = "com.attocube.ids.displacement.getAbsolutePositions";
+};
+struct ReferencePositions : Rpc<std::tuple<int, int64_t, int64_t, int64_t>> {
+    static constexpr std::string_view name = "com.attocube.ids.displacement.getReferencePositions";
+};
+struct MeasurementEnabled : Rpc<std::tuple<int, int>> {
+    static constexpr std::string_view name = "com.attocube.ids.displacement.getMeasurementEnabled";
+};
+struct CurrentMode : Rpc<std::tuple<RpcCodec::JsonString>> {
+    static constexpr std::string_view name = "com.attocube.ids.system.getCurrentMode";
+};
+struct DeviceType : Rpc<std::tuple<RpcCodec::JsonString>> {
+    static constexpr std::string_view name = "com.attocube.ids.system.getDeviceType";
+};
+struct FpgaVersion : Rpc<std::tuple<RpcCodec::JsonString>> {
+    static constexpr std::string_view name = "com.attocube.ids.system.getFpgaVersion";
+};
+struct StartMeasurement : Rpc<std::tuple<int>> {
+    static constexpr std::string_view name = "com.attocube.ids.system.startMeasurement";
+};
+struct StopMeasurement : Rpc<std::tuple<int>> {
+    static constexpr std::string_view name = "com.attocube.ids.system.stopMeasurement";
+};
+struct AxisSignalQuality : Rpc<std::tuple<int, int, int>, int> {
+    static constexpr std::string_view name = "com.attocube.ids.displacement.getAxisSignalQuality";
+};
+struct AdjustmentEnabled : Rpc<std::tuple<int, int>> {
+    static constexpr std::string_view name = "com.attocube.ids.adjustment.getAdjustmentEnabled";
+};
+struct EcuConnected : Rpc<std::tuple<int, int>> {
+    static constexpr std::string_view name = "com.attocube.ids.ecu.getConnected";
+};
+struct EcuTemperature : Rpc<std::tuple<int, double>> {
+    static constexpr std::string_view name = "com.attocube.ids.ecu.getTemperatureInDegrees";
+};
+struct EcuHumidity : Rpc<std::tuple<int, double>> {
+    static constexpr std::string_view name = "com.attocube.ids.ecu.getHumidityInPercent";
+};
+struct EcuPressure : Rpc<std::tuple<int, double>> {
+    static constexpr std::string_view name = "com.attocube.ids.ecu.getPressureInHPa";
+};
+struct EcuRefractiveIndex : Rpc<std::tuple<int, double>> {
+    static constexpr std::string_view name = "com.attocube.ids.ecu.getRefractiveIndex";
+};
+struct PilotLaserEnabled : Rpc<std::tuple<int, int>> {
+    static constexpr std::string_view name = "com.attocube.ids.pilotlaser.getEnabled";
+};
+}; // namespace Method
+
+namespace RpcCodec {
+
+/// @brief Appends characters to a fixed-size buffer, remembering if it ran out of room.
+class Writer {
+  public:
+    Writer(char* buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+    void put(std::string_view s) {
+        if (len_ + s.size() > cap_) {
+            overflow_ = true;
+            return;
+        }
+        std::memcpy(buf_ + len_, s.data(), s.size());
+        len_ += s.size();
+    }
+
+    template <typename T>
+    void put_number(T value) {
+        auto [end, ec] = std::to_chars(buf_ + len_, buf_ + cap_, value);
+        if (ec != std::errc()) {
+            overflow_ = true;
+            return;
+        }
+        len_ = end - buf_;
+    }
+
+    size_t size() const { return len_; }
+    bool overflow() const { return overflow_; }
+
+  private:
+    char* buf_;
+    size_t cap_;
+    size_t len_ = 0;
+    bool overflow_ = false;
+};
+
+inline void encode_param(Writer& w, bool value) { w.put(value ? "true" : "false"); }
+
+template <typename T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, int> = 0>
+void encode_param(Writer& w, T value) {
+    w.put_number(value);
+}
+
+/// @brief Writes a JSON string, escaping what RFC 8259 does not allow unescaped.
+inline void encode_param(Writer& w, std::string_view value) {
+    w.put("\"");
+    for (char c : value) {
+        switch (c) {
+        case '"':
+            w.put("\\\"");
+            break;
+        case '\\':
+            w.put("\\\\");
+            break;
+        case '\n':
+            w.put("\\n");
+            break;
+        case '\r':
+            w.put("\\r");
+            break;
+        case '\t':
+            w.put("\\t");
+            break;
+        case '\b':
+            w.put("\\b");
+            break;
+        case '\f':
+            w.put("\\f");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                static constexpr char HEX[] = "0123456789abcdef";
+                const char escape[] = {'\\', 'u', '0', '0', HEX[(c >> 4) & 0xf], HEX[c & 0xf]};
+                w.put(std::string_view(escape, sizeof(escape)));
+            } else {
+                w.put(std::string_view(&c, 1));
+            }
+        }
+    }
+    w.put("\"");
+}
+
+// without this a string literal would pick the bool overload
+inline void encode_param(Writer& w, const char* value) { encode_param(w, std::string_view(value)); }
+
+/// @brief Writes the JSON-RPC request for method M into buf.
+///
+/// @return Number of characters written, or std::nullopt if buf is too small.
+template <typename M, typename... Args>
+std::optional<size_t> encode(char* buf, size_t cap, const Args&... args) {
+    using Params = typename M::params_type;
+    static_assert(sizeof...(Args) == std::tuple_size_v<Params>, "wrong number of parameters for RPC method");
+    static_assert(std::is_constructible_v<Params, const Args&...>, "parameter types do not match RPC method");
+
+    Writer w(buf, cap);
+    w.put(R"({"jsonrpc":"2.0","id":1,"method":")");
+    w.put(M::name);
+    w.put("\"");
+    if constexpr (sizeof...(Args) > 0) {
+        // convert to the declared parameter types first so e.g. an enum is encoded like an int
+        Params params(args...);
+        w.put(",\"params\":[");
+        std::apply(
+            [&w](const auto&... p) {
+                size_t i = 0;
+                ((i++ ? w.put(",") : void(), encode_param(w, p)), ...);
+            },
+            params);
+        w.put("]");
+    }
+    w.put("}");
+
+    if (w.overflow())
+        return std::nullopt;
+    return w.size();
+}
+
+/// @brief Minimal forward-only JSON scanner over the receive buffer.
+///
+/// Only what is needed to pull the "result" array out of a reply is implemented. Everything
+/// else in the reply is skipped without being materialised.
+class Cursor {
+  public:
+    static constexpr int MAX_DEPTH = 32; ///< Nesting of arrays and objects skip_value() accepts.
+
+    Cursor(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+    void skip_ws() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+            ++p_;
+    }
+
+    bool consume(char c) {
+        skip_ws();
+        if (p_ < end_ && *p_ == c) {
+            ++p_;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char c) {
+        skip_ws();
+        return p_ < end_ && *p_ == c;
+    }
+
+    /// @brief Reads a string token without unescaping it.
+    /// @param raw Set to the characters between the quotes.
+    /// @param escaped Set to true if the string contains escape sequences.
+    bool raw_string(std::string_view& raw, bool& escaped) {
+        if (!consume('"'))
+            return false;
+        const char* start = p_;
+        escaped = false;
+        while (p_ < end_ && *p_ != '"') {
+            if (*p_ == '\\') {
+                escaped = true;
+                ++p_;
+            }
+            ++p_;
+        }
+        if (p_ >= end_)
+            return false;
+        raw = std::string_view(start, p_ - start);
+        ++p_;
+        return true;
+    }
+
+    /// @brief Returns the characters of a number, true, false or null token.
+    std::string_view scalar() {
+        skip_ws();
+        const char* start = p_;
+        while (p_ < end_ && *p_ != ',' && *p_ != ']' && *p_ != '}' && *p_ != ' ' && *p_ != '\n' && *p_ != '\r' &&
+               *p_ != '\t')
+            ++p_;
+        return std::string_view(start, p_ - start);
+    }
+
+    /// @brief Whether tok is a JSON number, true, false or null.
+    static bool is_scalar(std::string_view tok) {
+        if (tok == "true" || tok == "false" || tok == "null")
+            return true;
+        size_t i = 0;
+        auto digits = [&tok, &i] {
+            const size_t start = i;
+            while (i < tok.size() && tok[i] >= '0' && tok[i] <= '9')
+                ++i;
+            return i > start;
+        };
+        if (i < tok.size() && tok[i] == '-')
+            ++i;
+        if (i < tok.size() && tok[i] == '0')
+            ++i;
+        else if (!digits())
+            return false;
+        if (i < tok.size() && tok[i] == '.') {
+            ++i;
+            if (!digits())
+                return false;
+        }
+        if (i < tok.size() && (tok[i] == 'e' || tok[i] == 'E')) {
+            ++i;
+            if (i < tok.size() && (tok[i] == '+' || tok[i] == '-'))
+                ++i;
+            if (!digits())
+                return false;
+        }
+        return i == tok.size();
+    }
+
+    /// @brief Skips over one complete value of any type.
+    ///
+    /// @return false if the value is not well-formed JSON, e.g. an array with a missing
+    /// separator or element, or nests deeper than MAX_DEPTH.
+    bool skip_value(int depth = 0) {
+        skip_ws();
+        if (p_ >= end_ || depth > MAX_DEPTH)
+            return false;
+        if (*p_ == '"') {
+            std::string_view raw;
+            bool escaped;
+            return raw_string(raw, escaped);
+        }
+        if (*p_ == '[') {
+            ++p_;
+            if (consume(']'))
+                return true;
+            do {
+                if (!skip_value(depth + 1))
+                    return false;
+            } while (consume(','));
+            return consume(']');
+        }
+        if (*p_ == '{') {
+            ++p_;
+            if (consume('}'))
+                return true;
+            do {
+                std::string_view name;
+                bool escaped;
+                if (!raw_string(name, escaped) || !consume(':') || !skip_value(depth + 1))
+                    return false;
+            } while (consume(','));
+            return consume('}');
+        }
+        return is_scalar(scalar());
+    }
+
+  private:
+    const char* p_;
+    const char* end_;
+};
+
+/// @brief Calls put for each character of a raw JSON string with its escape sequences resolved.
+///
+/// @return false if an escape sequence is malformed.
+template <typename Put>
+bool for_each_unescaped(std::string_view raw, Put&& put) {
+    for (size_t i = 0; i < raw.size(); i++) {
+        char c = raw[i];
+        if (c != '\\') {
+            put(c);
+            continue;
+        }
+        if (++i >= raw.size())
+            return false;
+        switch (raw[i]) {
+        case 'n':
+            put('\n');
+            break;
+        case 't':
+            put('\t');
+            break;
+        case 'r':
+            put('\r');
+            break;
+        case 'b':
+            put('\b');
+            break;
+        case 'f':
+            put('\f');
+            break;
+        case 'u': {
+            // the controller only sends ASCII, anything else is replaced
+            if (i + 4 >= raw.size())
+                return false;
+            unsigned code = 0;
+            auto [ptr, ec] = std::from_chars(raw.data() + i + 1, raw.data() + i + 5, code, 16);
+            if (ec != std::errc() || ptr != raw.data() + i + 5)
+                return false;
+            put(code < 0x80 ? static_cast<char>(code) : '?');
+            i += 4;
+            break;
+        }
+        default:
+            put(raw[i]);
+        }
+    }
+    return true;
+}
+
+/// @brief Resolves the escape sequences of a raw JSON string into out.
+inline bool unescape(std::string_view raw, std::string& out) {
+    out.clear();
+    return for_each_unescaped(raw, [&out](char c) { out.push_back(c); });
+}
+
+inline bool JsonString::equals(std::string_view s) const {
+    if (!escaped)
+        return raw == s;
+    size_t n = 0;
+    bool same = true;
+    bool ok = for_each_unescaped(raw, [&](char c) {
+        same = same && n < s.size() && s[n] == c;
+        n++;
+    });
+    return ok && same && n == s.size();
+}
+
+inline bool JsonString::assign_to(std::string& out) const {
+    if (!escaped) {
+        out.assign(raw);
+        return true;
+    }
+    return unescape(raw, out);
+}
+
+inline bool decode_value(Cursor& c, bool& out) {
+    std::string_view tok = c.scalar();
+    if (tok == "true" || tok == "1") {
+        out = true;
+        return true;
+    }
+    if (tok == "false" || tok == "0") {
+        out = false;
+        return true;
+    }
+    return false;
+}
+
+template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+bool decode_value(Cursor& c, T& out) {
+    std::string_view tok = c.scalar();
+    // booleans are accepted as integers, like nlohmann::json does
+    if (tok == "true" || tok == "false") {
+        out = tok == "true";
+        return true;
+    }
+    auto [ptr, ec] = std::from_chars(tok.data(), tok.data() + tok.size(), out);
+    return ec == std::errc() && ptr == tok.data() + tok.size();
+}
+
+template <typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+bool decode_value(Cursor& c, T& out) {
+    std::string_view tok = c.scalar();
+    auto [ptr, ec] = std::from_chars(tok.data(), tok.data() + tok.size(), out);
+    return ec == std::errc() && ptr == tok.data() + tok.size();
+}
+
+inline bool decode_value(Cursor& c, JsonString& out) { return c.raw_string(out.raw, out.escaped); }
+
+inline bool decode_value(Cursor& c, std::string& out) {
+    JsonString str;
+    return decode_value(c, str) && str.assign_to(out);
+}
+
+/// @brief Whether a result layout holds views into the reply buffer.
+template <typename T>
+struct holds_views : std::false_type {};
+template <>
+struct holds_views<JsonString> : std::true_type {};
+template <typename... Ts>
+struct holds_views<std::tuple<Ts...>> : std::disjunction<holds_views<Ts>...> {};
+template <typename T, size_t N>
+struct holds_views<std::array<T, N>> : holds_views<T> {};
+template <typename T>
+inline constexpr bool holds_views_v = holds_views<T>::value;
+
+/// @brief Decodes the elements of a positional array into a tuple-like result.
+///
+/// Extra trailing elements sent by newer firmware are ignored, missing ones are an error.
+template <typename Tuple, size_t... I>
+bool decode_elements(Cursor& c, Tuple& out, std::index_sequence<I...>) {
+    if (!c.consume('['))
+        return false;
+    size_t n = 0;
+    bool ok = ((((n++ == 0) || c.consume(',')) && decode_value(c, std::get<I>(out))) && ...);
+    if (!ok)
+        return false;
+    while (c.consume(',')) {
+        if (!c.skip_value())
+            return false;
+    }
+    return c.consume(']');
+}
+
+template <typename... Ts>
+bool decode_value(Cursor& c, std::tuple<Ts...>& out) {
+    return decode_elements(c, out, std::index_sequence_for<Ts...>{});
+}
+
+template <typename T, size_t N>
+bool decode_value(Cursor& c, std::array<T, N>& out) {
+    return decode_elements(c, out, std::make_index_sequence<N>{});
+}
+
+/// @brief Decodes a JSON-RPC "error" object, unknown members such as "data" are skipped.
+inline bool decode_error(Cursor& c, RemoteError& remote) {
+    if (!c.consume('{'))
+        return false;
+    if (c.consume('}'))
+        return true;
+    do {
+        std::string_view name;
+        bool escaped;
+        if (!c.raw_string(name, escaped) || !c.consume(':'))
+            return false;
+        bool ok = name == "code" ? decode_value(c, remote.code)
+                  : name == "message" ? decode_value(c, remote.message)
+                                      : c.skip_value();
+        if (!ok)
+            return false;
+    } while (c.consume(','));
+    return c.consume('}');
+}
+
+/// @brief Decodes the "result" of a reply to method M, or the "error" sent instead.
+///
+/// @param result Set to the result in the layout declared by M on success.
+/// @param remote Set to the controller's error on RpcError::Remote, the message views the reply.
+/// @return RpcError::None on success, RpcError::Type if the result does not match the layout
+/// of M, RpcError::Remote if the controller sent an error, RpcError::Parse if the reply is not
+/// a JSON-RPC response.
+template <typename M>
+RpcError decode(const char* begin, const char* end, typename M::result_type& result, RemoteError& remote) {
+    Cursor c(begin, end);
+    if (!c.consume('{'))
+        return RpcError::Parse;
+    do {
+        std::string_view name;
+        bool escaped;
+        if (!c.raw_string(name, escaped) || !c.consume(':'))
+            return RpcError::Parse;
+        if (name == "result") {
+            Cursor start = c;
+            if (decode_value(c, result))
+                return RpcError::None;
+            // well-formed JSON in the wrong layout is a type mismatch, anything else garbage
+            return start.skip_value() ? RpcError::Type : RpcError::Parse;
+        }
+        if (name == "error")
+            return decode_error(c, remote) ? RpcError::Remote : RpcError::Parse;
+        if (!c.skip_value())
+            return RpcError::Parse;
+    } while (c.consume(','));
+    return RpcError::Parse;
+}
+
+} // namespace RpcCodec
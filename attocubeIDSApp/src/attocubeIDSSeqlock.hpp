@@ -0,0 +1,62 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/// @brief A single-writer, multi-reader sequence lock around a trivially copyable value.
+///
+/// The writer never waits and readers never block the writer: a reader copies the value and
+/// retries if the writer was active meanwhile. The value is stored as relaxed atomic words, so
+/// concurrent copies are well defined, and the whole object is cache-line aligned so it shares
+/// no line with unrelated data.
+template <typename T>
+class alignas(64) Seqlock {
+    static_assert(std::is_trivially_copyable_v<T>, "Seqlock needs a trivially copyable type");
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  public:
+    Seqlock() {
+        for (auto& w : words_)
+            w.store(0, std::memory_order_relaxed);
+    }
+
+    /// @brief Publishes a new value. Only one thread may call this.
+    void store(const T& value) {
+        std::array<uint64_t, WORDS> buf{};
+        std::memcpy(buf.data(), &value, sizeof(T));
+
+        uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++)
+            words_[i].store(buf[i], std::memory_order_relaxed);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    /// @brief Copies the newest complete value.
+    ///
+    /// @return The number of values published so far, 0 if value was not written.
+    uint64_t load(T& value) const {
+        std::array<uint64_t, WORDS> buf;
+        for (;;) {
+            uint64_t seq = seq_.load(std::memory_order_acquire);
+            if (seq & 1)
+                continue;
+            for (size_t i = 0; i < WORDS; i++)
+                buf[i] = words_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) != seq)
+                continue;
+            if (seq == 0)
+                return 0;
+            std::memcpy(&value, buf.data(), sizeof(T));
+            return seq / 2;
+        }
+    }
+
+  private:
+    std::atomic<uint64_t> seq_{0}; ///< Odd while a store is in progress.
+    std::array<std::atomic<uint64_t>, WORDS> words_;
+};
@@ -0,0 +1,222 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "attocubeIDSShm.h"
+
+// Layout of the segment: a header followed by num_slots slots. All fields the writer changes
+// after creation are atomics, the payload is accessed with relaxed operations and ordered by
+// the per-slot sequence lock.
+
+struct ShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t num_axes;
+    std::atomic<uint64_t> epoch; ///< When the segment was created, 0 once another replaced it.
+    alignas(64) std::atomic<uint64_t> write_seq; ///< Newest complete sample.
+};
+
+struct alignas(64) ShmSlot {
+    std::atomic<uint64_t> lock; ///< Odd while the slot is being written.
+    std::atomic<uint64_t> seq;
+    std::atomic<int64_t> realtime_ns;
+    std::atomic<int64_t> monotonic_ns;
+    std::atomic<uint32_t> valid_mask;
+    std::atomic<int64_t> displacement_pm[IDS_SHM_MAX_AXES];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory ring needs lock-free 64-bit atomics");
+
+static size_t segment_size(size_t num_slots) { return sizeof(ShmHeader) + num_slots * sizeof(ShmSlot); }
+
+static ShmSlot* slots_of(void* base) {
+    return reinterpret_cast<ShmSlot*>(static_cast<char*>(base) + sizeof(ShmHeader));
+}
+
+static uint64_t realtime_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000u + ts.tv_nsec;
+}
+
+// Marks an existing segment as replaced for the readers still mapping it
+static void retire_segment(const char* name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(ShmHeader)) {
+        void* base = mmap(nullptr, sizeof(ShmHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base != MAP_FAILED) {
+            auto* header = static_cast<ShmHeader*>(base);
+            if (header->magic == IDS_SHM_MAGIC && header->version == IDS_SHM_VERSION)
+                header->epoch.store(0, std::memory_order_release);
+            munmap(base, sizeof(ShmHeader));
+        }
+    }
+    close(fd);
+}
+
+ShmWriter* ShmWriter::create(const char* name, size_t num_slots) {
+    if (!name || num_slots == 0)
+        return nullptr;
+
+    // a new segment rather than resizing the old one in place: readers still mapping it would
+    // get SIGBUS for the pages cut off, and could take the new samples for old ones
+    retire_segment(name);
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        return nullptr;
+
+    size_t size = segment_size(num_slots);
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return nullptr;
+
+    auto* header = new (base) ShmHeader;
+    header->magic = IDS_SHM_MAGIC;
+    header->version = IDS_SHM_VERSION;
+    header->num_slots = num_slots;
+    header->num_axes = IDS_SHM_MAX_AXES;
+    header->write_seq.store(0, std::memory_order_relaxed);
+    ShmSlot* slots = slots_of(base);
+    for (size_t i = 0; i < num_slots; i++) {
+        new (&slots[i]) ShmSlot;
+        slots[i].lock.store(0, std::memory_order_relaxed);
+        slots[i].seq.store(0, std::memory_order_relaxed);
+    }
+    // stored last, readers do not use a segment before its epoch is set
+    header->epoch.store(realtime_ns(), std::memory_order_release);
+
+    auto* writer = new ShmWriter;
+    snprintf(writer->name_, sizeof(writer->name_), "%s", name);
+    writer->base_ = base;
+    writer->size_ = size;
+    return writer;
+}
+
+ShmWriter::~ShmWriter() {
+    if (base_)
+        munmap(base_, size_);
+}
+
+void ShmWriter::publish(const idsShmSample& sample) {
+    auto* header = static_cast<ShmHeader*>(base_);
+    uint64_t seq = ++seq_;
+    ShmSlot& slot = slots_of(base_)[seq % header->num_slots];
+
+    uint64_t lock = slot.lock.load(std::memory_order_relaxed);
+    slot.lock.store(lock + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.seq.store(seq, std::memory_order_relaxed);
+    slot.realtime_ns.store(sample.realtime_ns, std::memory_order_relaxed);
+    slot.monotonic_ns.store(sample.monotonic_ns, std::memory_order_relaxed);
+    slot.valid_mask.store(sample.valid_mask, std::memory_order_relaxed);
+    for (int i = 0; i < IDS_SHM_MAX_AXES; i++)
+        slot.displacement_pm[i].store(sample.displacement_pm[i], std::memory_order_relaxed);
+
+    slot.lock.store(lock + 2, std::memory_order_release);
+    header->write_seq.store(seq, std::memory_order_release);
+}
+
+struct idsShmReader {
+    void* base;
+    size_t size;
+    uint64_t epoch; ///< Epoch of the segment when it was opened.
+};
+
+extern "C" idsShmReader* idsShmOpen(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return nullptr;
+
+    auto* header = static_cast<const ShmHeader*>(base);
+    uint64_t epoch = header->epoch.load(std::memory_order_acquire);
+    // epoch 0: still being set up, or already replaced by a new segment
+    if (epoch == 0 || header->magic != IDS_SHM_MAGIC || header->version != IDS_SHM_VERSION ||
+        header->num_slots == 0 || segment_size(header->num_slots) > static_cast<size_t>(st.st_size)) {
+        munmap(base, st.st_size);
+        return nullptr;
+    }
+
+    return new idsShmReader{base, static_cast<size_t>(st.st_size), epoch};
+}
+
+extern "C" void idsShmClose(idsShmReader* reader) {
+    if (!reader)
+        return;
+    munmap(reader->base, reader->size);
+    delete reader;
+}
+
+extern "C" uint64_t idsShmLatestSeq(idsShmReader* reader) {
+    return static_cast<const ShmHeader*>(reader->base)->write_seq.load(std::memory_order_acquire);
+}
+
+extern "C" int idsShmRead(idsShmReader* reader, uint64_t seq, idsShmSample* sample) {
+    auto* header = static_cast<const ShmHeader*>(reader->base);
+    if (header->epoch.load(std::memory_order_acquire) != reader->epoch)
+        return IDS_SHM_RESTARTED;
+    if (seq == 0 || seq > header->write_seq.load(std::memory_order_acquire))
+        return IDS_SHM_NOT_YET;
+
+    const ShmSlot& slot = slots_of(reader->base)[seq % header->num_slots];
+    for (;;) {
+        uint64_t lock = slot.lock.load(std::memory_order_acquire);
+        if (lock & 1)
+            continue;
+
+        sample->seq = slot.seq.load(std::memory_order_relaxed);
+        sample->realtime_ns = slot.realtime_ns.load(std::memory_order_relaxed);
+        sample->monotonic_ns = slot.monotonic_ns.load(std::memory_order_relaxed);
+        sample->valid_mask = slot.valid_mask.load(std::memory_order_relaxed);
+        for (int i = 0; i < IDS_SHM_MAX_AXES; i++)
+            sample->displacement_pm[i] = slot.displacement_pm[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.lock.load(std::memory_order_relaxed) != lock)
+            continue;
+
+        if (sample->seq == seq)
+            return IDS_SHM_OK;
+        return sample->seq > seq ? IDS_SHM_OVERWRITTEN : IDS_SHM_NOT_YET;
+    }
+}
+
+extern "C" int idsShmReadLatest(idsShmReader* reader, idsShmSample* sample) {
+    for (;;) {
+        uint64_t seq = idsShmLatestSeq(reader);
+        if (seq == 0)
+            return IDS_SHM_NOT_YET;
+        // the newest slot can only be overwritten if the writer lapped us, then try again
+        int status = idsShmRead(reader, seq, sample);
+        if (status == IDS_SHM_OK || status == IDS_SHM_RESTARTED)
+            return status;
+    }
+}
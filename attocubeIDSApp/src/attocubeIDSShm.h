@@ -0,0 +1,104 @@
+#ifndef ATTOCUBE_IDS_SHM_H
+#define ATTOCUBE_IDS_SHM_H
+
+/*
+ * Shared-memory ring of displacement samples published by the AttocubeIDS driver
+ * (see AttocubeIDSShm in the iocsh) for consumers on the same host.
+ *
+ * The ring has a single writer, the acquisition thread of the driver, and any number of
+ * readers. Each slot is guarded by a sequence lock, so readers never block the writer
+ * and reading needs no system calls once the segment is mapped.
+ *
+ * Typical reader loop:
+ *
+ *     idsShmReader* r = idsShmOpen("/ids1");
+ *     uint64_t next = idsShmLatestSeq(r) + 1;
+ *     idsShmSample s;
+ *     for (;;) {
+ *         int status = idsShmRead(r, next, &s);
+ *         if (status == IDS_SHM_OK) { use(&s); next++; }
+ *         else if (status == IDS_SHM_OVERWRITTEN) next = idsShmLatestSeq(r);  // fell behind
+ *         else if (status == IDS_SHM_RESTARTED) {                           // new ring
+ *             idsShmClose(r);
+ *             while (!(r = idsShmOpen("/ids1"))) sleep(1);
+ *             next = idsShmLatestSeq(r) + 1;
+ *         }
+ *     }
+ *
+ * A driver that starts, or reconfigures the ring, creates a new segment under the name and
+ * marks the one mapped by existing readers as replaced; those readers then get
+ * IDS_SHM_RESTARTED and reopen. The sequence numbers of the new ring start at 1 again.
+ */
+
+#include <stdint.h>
+
+#define IDS_SHM_MAGIC 0x31534449u /* "IDS1" */
+#define IDS_SHM_VERSION 2u
+#define IDS_SHM_MAX_AXES 3
+
+#define IDS_SHM_OK 0
+#define IDS_SHM_NOT_YET 1      /* sample not written yet */
+#define IDS_SHM_OVERWRITTEN -1 /* sample already overwritten, the reader fell behind */
+#define IDS_SHM_RESTARTED -2   /* the ring was replaced by a new one, close and reopen it */
+
+typedef struct idsShmSample {
+    uint64_t seq;          /* sample number, the first sample is 1 */
+    int64_t realtime_ns;   /* CLOCK_REALTIME when the reply arrived */
+    int64_t monotonic_ns;  /* CLOCK_MONOTONIC when the reply arrived */
+    uint32_t valid_mask;   /* bit n set if displacement_pm[n] is valid */
+    int64_t displacement_pm[IDS_SHM_MAX_AXES];
+} idsShmSample;
+
+typedef struct idsShmReader idsShmReader;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Maps an existing ring read-only, returns NULL if it does not exist or is incompatible */
+idsShmReader* idsShmOpen(const char* name);
+void idsShmClose(idsShmReader* reader);
+
+/* Sequence number of the newest complete sample, 0 if there is none yet */
+uint64_t idsShmLatestSeq(idsShmReader* reader);
+
+/* Copies sample number seq, returns IDS_SHM_OK, IDS_SHM_NOT_YET, IDS_SHM_OVERWRITTEN or
+ * IDS_SHM_RESTARTED */
+int idsShmRead(idsShmReader* reader, uint64_t seq, idsShmSample* sample);
+
+/* Copies the newest sample, returns IDS_SHM_OK, IDS_SHM_NOT_YET or IDS_SHM_RESTARTED */
+int idsShmReadLatest(idsShmReader* reader, idsShmSample* sample);
+
+#ifdef __cplusplus
+}
+
+#include <cstddef>
+
+/// @brief Creates the ring and publishes samples into it, used by the driver.
+class ShmWriter {
+  public:
+    /// @brief Creates the shared-memory segment. An existing one of the same name is marked
+    /// as replaced for its readers and unlinked, it stays valid for as long as they map it.
+    ///
+    /// @param name POSIX shared-memory name, e.g. "/ids1".
+    /// @param num_slots Number of samples kept in the ring.
+    /// @return The writer, nullptr if the segment could not be created.
+    static ShmWriter* create(const char* name, size_t num_slots);
+    ~ShmWriter();
+
+    /// @brief Publishes one sample, the seq field is assigned here. Never blocks.
+    void publish(const idsShmSample& sample);
+
+    const char* name() const { return name_; }
+    uint64_t last_seq() const { return seq_; }
+
+  private:
+    ShmWriter() = default;
+    char name_[64] = {};
+    void* base_ = nullptr;
+    size_t size_ = 0;
+    uint64_t seq_ = 0;
+};
+#endif
+
+#endif /* ATTOCUBE_IDS_SHM_H */
@@ -0,0 +1,61 @@
+#ifndef ATTOCUBE_IDS_SNAPSHOT_H
+#define ATTOCUBE_IDS_SNAPSHOT_H
+
+/*
+ * Lock-free access to the newest positions of an AttocubeIDS port for other drivers in the
+ * same IOC, without going through the asyn port lock.
+ *
+ * The driver publishes one snapshot per poll cycle through a sequence lock, readers copy it
+ * and never contend with the poller or with each other:
+ *
+ *     idsSnapshotSource* ids = idsSnapshotFind("IDS1");   // once, e.g. in the driver constructor
+ *     idsSnapshot snap;
+ *     if (idsSnapshotRead(ids, &snap) == 0 && (snap.valid_mask & IDS_SNAPSHOT_DISP(0)))
+ *         use(snap.axis[0].displacement_pm, &snap.axis[0].displacement_time);
+ *
+ * While a source has been found by a reader the displacement and absolute positions are read
+ * from the controller every poll cycle, even if no records are interested in them.
+ */
+
+#include <epicsTime.h>
+#include <epicsTypes.h>
+
+#define IDS_SNAPSHOT_AXES 3
+
+/* valid_mask bits, set if the value was read successfully in the snapshot's cycle */
+#define IDS_SNAPSHOT_DISP(axis) (1u << (axis))
+#define IDS_SNAPSHOT_ABS(axis) (1u << (8 + (axis)))
+
+typedef struct idsSnapshotAxis {
+    epicsInt64 displacement_pm;
+    epicsInt64 absolute_pm;
+    double displacement;     /* engineering units, see the Scale/Offset records */
+    double absolute;         /* engineering units */
+    double velocity;         /* engineering units per second */
+    epicsTimeStamp displacement_time;
+    epicsTimeStamp absolute_time;
+} idsSnapshotAxis;
+
+typedef struct idsSnapshot {
+    epicsUInt64 cycle; /* poll cycle the snapshot belongs to */
+    epicsUInt32 valid_mask;
+    idsSnapshotAxis axis[IDS_SNAPSHOT_AXES];
+} idsSnapshot;
+
+typedef struct idsSnapshotSource idsSnapshotSource;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Finds the AttocubeIDS port of that name, NULL if there is none */
+idsSnapshotSource* idsSnapshotFind(const char* port);
+
+/* Copies the newest snapshot, returns 0 on success, -1 if none was published yet */
+int idsSnapshotRead(const idsSnapshotSource* source, idsSnapshot* snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ATTOCUBE_IDS_SNAPSHOT_H */
@@ -0,0 +1,297 @@
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <epicsThread.h>
+
+#include "attocubeIDSLog.hpp"
+#include "attocubeIDSTransport.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static int remaining_ms(Clock::time_point deadline) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
+
+EventLoop& EventLoop::shared() {
+    static EventLoop* loop = new EventLoop();
+    return *loop;
+}
+
+EventLoop::EventLoop() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        printf("AttocubeIDS: epoll_create1 failed: %s\n", strerror(errno));
+        return;
+    }
+    epicsThreadCreate(
+        "AttocubeIDSNet", epicsThreadPriorityMedium, epicsThreadGetStackSize(epicsThreadStackSmall),
+        [](void* loop) { static_cast<EventLoop*>(loop)->run(); }, this);
+}
+
+bool EventLoop::add(int fd, NativeConnection* conn) {
+    if (epoll_fd_ < 0)
+        return false;
+    std::lock_guard<std::mutex> guard(mutex_);
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev))
+        return false;
+    registered_.insert(conn);
+    return true;
+}
+
+void EventLoop::remove(int fd, NativeConnection* conn) {
+    // waits for the batch of events being handled, which may still refer to conn
+    std::lock_guard<std::mutex> guard(mutex_);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    registered_.erase(conn);
+}
+
+void EventLoop::drop(int fd, NativeConnection* conn) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    registered_.erase(conn);
+}
+
+void EventLoop::run() {
+    std::array<epoll_event, 64> events;
+    while (true) {
+        int n = epoll_wait(epoll_fd_, events.data(), events.size(), -1);
+        if (n < 0) {
+            if (errno != EINTR)
+                Logger::shared().log(LogClass::Internal, "AttocubeIDSNet", "epoll_wait failed: %s", strerror(errno));
+            continue;
+        }
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (int i = 0; i < n; i++) {
+            auto* conn = static_cast<NativeConnection*>(events[i].data.ptr);
+            if (registered_.count(conn))
+                conn->on_readable();
+        }
+    }
+}
+
+std::unique_ptr<NativeConnection> NativeConnection::create(const std::string& address, std::string& error) {
+    auto colon = address.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == address.size()) {
+        error = "expected host:port, got \"" + address + "\"";
+        return nullptr;
+    }
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &result)) {
+        error = "cannot resolve " + address + ": " + gai_strerror(err);
+        return nullptr;
+    }
+    sockaddr_in addr;
+    std::memcpy(&addr, result->ai_addr, sizeof(addr));
+    freeaddrinfo(result);
+
+    // EventLoop must be running before the first reply can arrive
+    EventLoop::shared();
+    return std::unique_ptr<NativeConnection>(new NativeConnection(address, addr));
+}
+
+NativeConnection::~NativeConnection() {
+    std::lock_guard<std::mutex> guard(exchange_mutex_);
+    disconnect();
+}
+
+bool NativeConnection::connect(double timeout) {
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr_), sizeof(addr_)) && errno != EINPROGRESS) {
+        close(fd);
+        return false;
+    }
+    pollfd pfd{fd, POLLOUT, 0};
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+    if (poll(&pfd, 1, remaining_ms(deadline)) != 1 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) ||
+        err) {
+        close(fd);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        fd_ = fd;
+        broken_ = false;
+    }
+    if (!EventLoop::shared().add(fd, this)) {
+        disconnect();
+        return false;
+    }
+    connects_++;
+    return true;
+}
+
+void NativeConnection::disconnect() {
+    if (fd_ < 0)
+        return;
+    EventLoop::shared().remove(fd_, this);
+    std::lock_guard<std::mutex> guard(mutex_);
+    close(fd_);
+    fd_ = -1;
+}
+
+void NativeConnection::on_readable() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::array<char, 256> discard;
+    while (fd_ >= 0) {
+        // bytes nobody waits for are left over from an abandoned exchange
+        bool wanted = pending_ && !pending_->done;
+        char* dst = wanted ? pending_->in + pending_->len : discard.data();
+        size_t room = wanted ? pending_->size - pending_->len : discard.size();
+        if (wanted && room == 0) {
+            pending_->status = asynOverflow;
+            pending_->done = true;
+            reply_ready_.notify_one();
+            return;
+        }
+
+        ssize_t n = recv(fd_, dst, room, MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return;
+        if (n <= 0) {
+            // closed by the controller or broken: the fd leaves the level triggered epoll set
+            // at once, which would report it readable again and again, the exchange waiting
+            // fails and the next one reconnects
+            EventLoop::shared().drop(fd_, this);
+            broken_ = true;
+            if (pending_ && !pending_->done) {
+                pending_->status = asynError;
+                pending_->done = true;
+                reply_ready_.notify_one();
+            }
+            // the fd is closed here if no exchange uses it, otherwise by that exchange
+            if (exchange_mutex_.try_lock()) {
+                close(fd_);
+                fd_ = -1;
+                exchange_mutex_.unlock();
+            }
+            return;
+        }
+        if (!wanted)
+            continue;
+
+        if (auto* eol = static_cast<char*>(std::memchr(dst, '\n', n))) {
+            pending_->len += eol - dst;
+            pending_->done = true;
+            reply_ready_.notify_one();
+        } else {
+            pending_->len += n;
+        }
+    }
+}
+
+asynStatus NativeConnection::write_read(const char* out, size_t out_len, char* in, size_t in_size,
+                                        double timeout, size_t* nbytesout, size_t* nbytesin, int* eom_reason) {
+    Exchange exchange;
+    begin(exchange, out, out_len, in, in_size, timeout, true);
+    return end(exchange, nbytesout, nbytesin, eom_reason);
+}
+
+bool NativeConnection::begin(Exchange& exchange, const char* out, size_t out_len, char* in, size_t in_size,
+                             double timeout, bool wait) {
+    if (wait)
+        exchange_mutex_.lock();
+    else if (!exchange_mutex_.try_lock())
+        return false;
+    exchange = Exchange{};
+    exchange.in = in;
+    exchange.size = in_size;
+    exchange.deadline =
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeout));
+    exchanges_++;
+
+    bool broken;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        broken = broken_;
+    }
+    if (broken)
+        disconnect();
+    if (fd_ < 0 && !connect(timeout)) {
+        exchange.status = asynError;
+        exchange.done = true;
+        return true;
+    }
+
+    asynStatus status = asynSuccess;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        pending_ = &exchange;
+        // broke after the check above, no reply can arrive on it
+        if (broken_)
+            status = asynError;
+    }
+
+    while (status == asynSuccess && exchange.sent < out_len) {
+        ssize_t n = send(fd_, out + exchange.sent, out_len - exchange.sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            exchange.sent += n;
+            continue;
+        }
+        pollfd pfd{fd_, POLLOUT, 0};
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+            poll(&pfd, 1, remaining_ms(exchange.deadline)) == 1)
+            continue;
+        status = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? asynTimeout : asynError;
+    }
+    if (status != asynSuccess) {
+        // end() reports it without waiting
+        std::lock_guard<std::mutex> guard(mutex_);
+        exchange.status = status;
+        exchange.done = true;
+    }
+    return true;
+}
+
+asynStatus NativeConnection::end(Exchange& exchange, size_t* nbytesout, size_t* nbytesin, int* eom_reason) {
+    // begin() locked exchange_mutex_ for this exchange
+    std::lock_guard<std::mutex> exchange_guard(exchange_mutex_, std::adopt_lock);
+    asynStatus status;
+    {
+        std::unique_lock<std::mutex> guard(mutex_);
+        if (reply_ready_.wait_until(guard, exchange.deadline, [&] { return exchange.done; }))
+            status = exchange.status;
+        else
+            status = asynTimeout;
+        pending_ = nullptr;
+    }
+
+    *nbytesout = exchange.sent;
+    *nbytesin = 0;
+    *eom_reason = 0;
+    if (status == asynSuccess) {
+        *nbytesin = exchange.len;
+        *eom_reason = ASYN_EOM_EOS;
+    } else {
+        failures_++;
+        disconnect();
+    }
+    return status;
+}
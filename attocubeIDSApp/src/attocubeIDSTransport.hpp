@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+#include <netinet/in.h>
+
+#include <asynDriver.h>
+
+class NativeConnection;
+
+/// @brief One thread waiting on an epoll set for replies on all native connections.
+///
+/// The loop reads a reply straight into the buffer of the request waiting for it and wakes
+/// the requesting thread once the terminating newline arrived. Connections register and
+/// unregister themselves, the loop never touches a connection that is not registered.
+class EventLoop {
+  public:
+    /// @brief The loop shared by all native connections, started on first use.
+    static EventLoop& shared();
+
+    bool add(int fd, NativeConnection* conn);
+    void remove(int fd, NativeConnection* conn);
+
+  private:
+    friend class NativeConnection;
+
+    EventLoop();
+    void run();
+    /// @brief remove() for an event handler, which runs with mutex_ held.
+    void drop(int fd, NativeConnection* conn);
+
+    int epoll_fd_ = -1;
+    std::mutex mutex_; ///< Held while events are handled, guards registered_.
+    std::unordered_set<NativeConnection*> registered_;
+};
+
+/// @brief A TCP connection to the controller without the asyn IP port in between.
+///
+/// Requests are sent from the calling thread on a non-blocking socket with TCP_NODELAY, the
+/// shared EventLoop collects the newline-terminated reply. The caller either waits for it
+/// (write_read) or carries on and picks it up later (begin and end), so no thread sits
+/// blocked while the reply travels. One exchange is in flight at a time; a timed out
+/// exchange drops the connection so a late reply cannot be taken for the next one, and the
+/// next exchange connects again. A connection the controller closed or that broke leaves the
+/// epoll set at once and is reconnected by the next exchange.
+class NativeConnection {
+  public:
+    /// @brief One request and its reply, the reply is filled in by the event loop.
+    struct Exchange {
+        char* in = nullptr;
+        size_t size = 0;
+        size_t len = 0;  ///< Reply bytes read so far, without the terminator.
+        size_t sent = 0; ///< Request bytes sent.
+        bool done = false;
+        asynStatus status = asynSuccess;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    /// @brief Resolves the controller address, the connection is made by the first exchange.
+    ///
+    /// @param address "host:port".
+    /// @param error Set to a description of the problem on failure.
+    /// @return nullptr if the address is invalid or cannot be resolved.
+    static std::unique_ptr<NativeConnection> create(const std::string& address, std::string& error);
+
+    ~NativeConnection();
+    NativeConnection(const NativeConnection&) = delete;
+    NativeConnection& operator=(const NativeConnection&) = delete;
+
+    /// @brief Sends a request and reads the reply, like pasynOctetSyncIO->writeRead with "\n"
+    /// as input terminator.
+    ///
+    /// @return asynSuccess, asynTimeout if no complete reply arrived in time, asynOverflow if
+    /// the reply does not fit into in, asynError if the connection failed.
+    asynStatus write_read(const char* out, size_t out_len, char* in, size_t in_size, double timeout,
+                          size_t* nbytesout, size_t* nbytesin, int* eom_reason);
+
+    /// @brief Sends a request and returns, the event loop reads the reply into in. Every
+    /// begin() that returned true must be followed by end() on the same thread.
+    ///
+    /// @param wait false to return at once if another exchange is in flight.
+    /// @return false if nothing was sent because another exchange is in flight.
+    bool begin(Exchange& exchange, const char* out, size_t out_len, char* in, size_t in_size, double timeout,
+               bool wait);
+
+    /// @brief Waits for the reply of an exchange started by begin(), with the same results
+    /// as write_read.
+    asynStatus end(Exchange& exchange, size_t* nbytesout, size_t* nbytesin, int* eom_reason);
+
+    const std::string& address() const { return address_; }
+    uint64_t exchanges() const { return exchanges_.load(std::memory_order_relaxed); }
+    uint64_t connects() const { return connects_.load(std::memory_order_relaxed); }
+    uint64_t failures() const { return failures_.load(std::memory_order_relaxed); }
+
+  private:
+    friend class EventLoop;
+
+    NativeConnection(std::string address, const sockaddr_in& addr) : address_(std::move(address)), addr_(addr) {}
+    bool connect(double timeout);
+    void disconnect();
+    void on_readable();
+
+    const std::string address_;
+    const sockaddr_in addr_;
+
+    std::mutex exchange_mutex_; ///< Held from begin() to end(), guards connecting and closing.
+    std::mutex mutex_;          ///< Shared with the event loop, guards fd_ and pending_.
+    std::condition_variable reply_ready_;
+    int fd_ = -1;
+    bool broken_ = false; ///< fd_ was closed by the controller or failed, it is no longer polled.
+    Exchange* pending_ = nullptr;
+
+    // read by dbior while exchanges run
+    std::atomic<uint64_t> exchanges_{0};
+    std::atomic<uint64_t> connects_{0};
+    std::atomic<uint64_t> failures_{0};
+};
@@ -0,0 +1,315 @@
+// Loopback benchmark of the two AttocubeIDS transports: the asyn IP port with
+// pasynOctetSyncIO->writeRead, and the native epoll transport (NativeConnection).
+//
+// Usage: attocubeIDSTransportBench [-n rpcs] [-d reply delay us] [host:port]
+//
+// Without an address a minimal JSON-RPC responder is started on the loopback interface that
+// answers every request with a fixed getAxesDisplacement reply, so only the transports are
+// measured; -d makes it wait before each reply, like a controller busy with the request.
+// With an address the requests go to that controller or simulator instead.
+// For each transport the per-RPC latency (min, median, 99th percentile, max) and the process
+// CPU time per RPC are printed. With the built-in responder the CPU time includes the
+// responder, which costs the same for both transports.
+//
+// The second table is the latency of a poll cycle of CYCLE_RPCS requests over 1 to
+// MAX_CONNECTIONS connections: the first request (the displacement) has connection 0 to
+// itself, the others take turns on the remaining ones and are sent at the same time from a
+// thread per connection, as the driver does with a pool of connections.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <asynOctetSyncIO.h>
+#include <drvAsynIPPort.h>
+
+#include "attocubeIDSTransport.hpp"
+
+static const char REQUEST[] = R"({"jsonrpc":"2.0","id":1,"method":"com.attocube.ids.displacement.getAxesDisplacement"})";
+static const char REPLY[] = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":[0,123456789012,-98765432109,42]}\n";
+static constexpr double TIMEOUT = 1.0;
+static constexpr int WARMUP = 100;
+// a poll cycle: displacement, absolute and reference positions, measurement state
+static constexpr int CYCLE_RPCS = 4;
+static constexpr size_t MAX_CONNECTIONS = 4; // as in the driver
+
+static int reply_delay_us = 0;
+
+// Answers each complete JSON object received with REPLY, one thread per client
+static void serve(int listen_fd) {
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        std::thread([fd] {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            char buf[1024];
+            int depth = 0;
+            ssize_t n;
+            while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+                for (ssize_t i = 0; i < n; i++) {
+                    if (buf[i] == '{')
+                        depth++;
+                    else if (buf[i] == '}' && --depth == 0) {
+                        if (reply_delay_us)
+                            std::this_thread::sleep_for(std::chrono::microseconds(reply_delay_us));
+                        send(fd, REPLY, sizeof(REPLY) - 1, MSG_NOSIGNAL);
+                    }
+                }
+            }
+            close(fd);
+        }).detach();
+    }
+}
+
+static std::string start_responder() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) || listen(fd, 8) ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len)) {
+        perror("responder");
+        exit(1);
+    }
+    std::thread(serve, fd).detach();
+    return "127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+}
+
+static double cpu_seconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 1e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+// Runs rpcs exchanges and prints their statistics, exchange returns false on failure
+static void measure(const char* name, int rpcs, const std::function<bool()>& exchange) {
+    for (int i = 0; i < WARMUP; i++) {
+        if (!exchange()) {
+            printf("%-8s exchange failed\n", name);
+            return;
+        }
+    }
+
+    std::vector<double> latency_us;
+    latency_us.reserve(rpcs);
+    int failed = 0;
+    double cpu_start = cpu_seconds();
+    for (int i = 0; i < rpcs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        failed += !exchange();
+        latency_us.push_back(
+            std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    double cpu_us = 1e6 * (cpu_seconds() - cpu_start) / rpcs;
+
+    std::sort(latency_us.begin(), latency_us.end());
+    printf("%-8s %8.1f %8.1f %8.1f %8.1f %10.1f %7d\n", name, latency_us.front(), latency_us[rpcs / 2],
+           latency_us[rpcs * 99 / 100], latency_us.back(), cpu_us, failed);
+}
+
+// One exchange per connection of a pool, the poll cycle spread over them by run()
+class CycleRunner {
+  public:
+    explicit CycleRunner(std::vector<std::function<bool()>> exchanges)
+        : exchanges_(std::move(exchanges)), lanes_(exchanges_.size()) {
+        for (size_t i = 1; i < lanes_.size(); i++)
+            lanes_[i].thread = std::thread([this, i] { lane(i); });
+    }
+
+    ~CycleRunner() {
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            quit_ = true;
+        }
+        start_.notify_all();
+        for (size_t i = 1; i < lanes_.size(); i++)
+            lanes_[i].thread.join();
+    }
+
+    // Sends one cycle, false if a request failed
+    bool run() {
+        if (lanes_.size() == 1)
+            return send(0, CYCLE_RPCS);
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            cycle_++;
+            busy_ = lanes_.size() - 1;
+            ok_ = true;
+        }
+        start_.notify_all();
+        bool ok = send(0, 1);
+        std::unique_lock<std::mutex> guard(mutex_);
+        done_.wait(guard, [this] { return busy_ == 0; });
+        return ok && ok_;
+    }
+
+  private:
+    struct Lane {
+        std::thread thread;
+        uint64_t cycle = 0;
+    };
+
+    bool send(size_t conn, int rpcs) {
+        bool ok = true;
+        for (int i = 0; i < rpcs; i++)
+            ok &= exchanges_[conn]();
+        return ok;
+    }
+
+    // Connection i > 0 sends the requests 1..CYCLE_RPCS-1 that fall on it
+    void lane(size_t i) {
+        const size_t shared = lanes_.size() - 1;
+        int rpcs = 0;
+        for (int r = 1; r < CYCLE_RPCS; r++)
+            rpcs += 1 + (r - 1) % shared == i;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(mutex_);
+                start_.wait(guard, [&] { return quit_ || cycle_ != lanes_[i].cycle; });
+                if (quit_)
+                    return;
+                lanes_[i].cycle = cycle_;
+            }
+            bool ok = send(i, rpcs);
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                ok_ = ok_ && ok;
+                busy_--;
+            }
+            done_.notify_one();
+        }
+    }
+
+    std::vector<std::function<bool()>> exchanges_;
+    std::vector<Lane> lanes_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    uint64_t cycle_ = 0;
+    size_t busy_ = 0;
+    bool ok_ = true;
+    bool quit_ = false;
+};
+
+// Per-cycle latency over 1..MAX_CONNECTIONS connections, connect(i) returns the exchange of
+// connection i or an empty function if it cannot be set up
+static void measure_cycles(const char* name, int cycles,
+                           const std::function<std::function<bool()>(size_t)>& connect) {
+    std::vector<std::function<bool()>> exchanges;
+    for (size_t k = 1; k <= MAX_CONNECTIONS; k++) {
+        exchanges.push_back(connect(k - 1));
+        if (!exchanges.back()) {
+            printf("%s: could not open connection %zu\n", name, k);
+            return;
+        }
+        CycleRunner runner(exchanges);
+        std::string label = std::string(name) + " " + std::to_string(k);
+        measure(label.c_str(), cycles, [&] { return runner.run(); });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int rpcs = 10000;
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (std::strcmp(argv[arg], "-n") == 0)
+            rpcs = std::atoi(argv[arg + 1]);
+        else if (std::strcmp(argv[arg], "-d") == 0)
+            reply_delay_us = std::atoi(argv[arg + 1]);
+        else
+            break;
+        arg += 2;
+    }
+    if (rpcs <= 0 || reply_delay_us < 0 || argc - arg > 1) {
+        fprintf(stderr, "usage: %s [-n rpcs] [-d reply delay us] [host:port]\n", argv[0]);
+        return 1;
+    }
+    std::string address = arg < argc ? argv[arg] : start_responder();
+    printf("%d RPCs to %s\n", rpcs, address.c_str());
+    printf("%-8s %8s %8s %8s %8s %10s %7s\n", "", "min us", "med us", "p99 us", "max us", "cpu us/rpc", "failed");
+
+    char in[512];
+    size_t nout, nin;
+    int eom;
+
+    drvAsynIPPortConfigure("BENCH", address.c_str(), 0, 0, 0);
+    asynUser* pasynUser = nullptr;
+    if (pasynOctetSyncIO->connect("BENCH", 0, &pasynUser, NULL)) {
+        printf("asyn     could not connect\n");
+    } else {
+        pasynOctetSyncIO->setInputEos(pasynUser, "\n", 1);
+        measure("asyn", rpcs, [&] {
+            return pasynOctetSyncIO->writeRead(pasynUser, REQUEST, sizeof(REQUEST) - 1, in, sizeof(in), TIMEOUT,
+                                               &nout, &nin, &eom) == asynSuccess;
+        });
+    }
+
+    std::string error;
+    auto native = NativeConnection::create(address, error);
+    if (!native) {
+        printf("native   %s\n", error.c_str());
+    } else {
+        measure("native", rpcs, [&] {
+            return native->write_read(REQUEST, sizeof(REQUEST) - 1, in, sizeof(in), TIMEOUT, &nout, &nin, &eom) ==
+                   asynSuccess;
+        });
+    }
+
+    int cycles = std::max(rpcs / CYCLE_RPCS, 1);
+    printf("\n%d poll cycles of %d RPCs over 1 to %zu connections\n", cycles, CYCLE_RPCS, MAX_CONNECTIONS);
+    printf("%-8s %8s %8s %8s %8s %10s %7s\n", "", "min us", "med us", "p99 us", "max us", "cpu us/cyc", "failed");
+
+    // each connection has its own buffers, as each of the driver has its own I/O contexts
+    measure_cycles("asyn", cycles, [&](size_t i) -> std::function<bool()> {
+        std::string port = "BENCH" + std::to_string(i);
+        drvAsynIPPortConfigure(port.c_str(), address.c_str(), 0, 0, 0);
+        asynUser* user = nullptr;
+        if (pasynOctetSyncIO->connect(port.c_str(), 0, &user, NULL))
+            return nullptr;
+        pasynOctetSyncIO->setInputEos(user, "\n", 1);
+        auto buf = std::make_shared<std::array<char, 512>>();
+        return [user, buf] {
+            size_t nout, nin;
+            int eom;
+            return pasynOctetSyncIO->writeRead(user, REQUEST, sizeof(REQUEST) - 1, buf->data(), buf->size(),
+                                               TIMEOUT, &nout, &nin, &eom) == asynSuccess;
+        };
+    });
+
+    std::vector<std::shared_ptr<NativeConnection>> conns;
+    measure_cycles("native", cycles, [&](size_t) -> std::function<bool()> {
+        std::string error;
+        std::shared_ptr<NativeConnection> conn = NativeConnection::create(address, error);
+        if (!conn)
+            return nullptr;
+        conns.push_back(conn);
+        auto buf = std::make_shared<std::array<char, 512>>();
+        return [conn, buf] {
+            size_t nout, nin;
+            int eom;
+            return conn->write_read(REQUEST, sizeof(REQUEST) - 1, buf->data(), buf->size(), TIMEOUT, &nout,
+                                    &nin, &eom) == asynSuccess;
+        };
+    });
+    return 0;
+}
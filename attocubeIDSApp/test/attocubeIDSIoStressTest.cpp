@@ -0,0 +1,94 @@
+// Threads sharing an IoContextPool and its connection, as the RPC paths of the driver do, over
+// both transports: every exchange has to come back with the reply to its own request. Also
+// meant to be run under ThreadSanitizer, e.g.
+//     make USR_CXXFLAGS+=-fsanitize=thread USR_LDFLAGS+=-fsanitize=thread runtests
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asynOctetSyncIO.h>
+#include <drvAsynIPPort.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "attocubeIDSIo.hpp"
+#include "attocubeIDSTransport.hpp"
+#include "idsSim.h"
+
+static constexpr int THREADS = 8;
+static constexpr size_t CONTEXTS = 4;
+static constexpr int RPCS = 2000; // per thread
+
+// One exchange over native if given, else over the context's asyn IP port
+static asynStatus exchange(NativeConnection* native, IoContext& io, size_t len) {
+    if (native)
+        return native->write_read(io.out.data(), len, io.in.data(), io.in.size(), 5.0, &io.nbytesout,
+                                  &io.nbytesin, &io.eom_reason);
+    return pasynOctetSyncIO->writeRead(io.pasynUser, io.out.data(), len, io.in.data(), io.in.size(), 5.0,
+                                       &io.nbytesout, &io.nbytesin, &io.eom_reason);
+}
+
+// THREADS threads send RPCS tagged echo requests each through the contexts of pool
+static void stress(const char* transport, IoContextPool& pool, NativeConnection* native, const IdsSim& sim) {
+    const uint64_t requests = sim.requests();
+    std::atomic<int> failed{0};
+    std::atomic<int> mixed_up{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < RPCS; i++) {
+                auto io = pool.acquire();
+                const std::string tag = std::to_string(t * 1000000 + i);
+                const std::string request =
+                    R"({"jsonrpc":"2.0","id":1,"method":"com.attocube.test.echo","params":[)" + tag + "]}";
+                request.copy(io->out.data(), io->out.size());
+                if (exchange(native, *io, request.size()) != asynSuccess) {
+                    failed++;
+                    continue;
+                }
+                const std::string reply(io->in.data(), io->nbytesin);
+                if (reply.find("\"result\":[0," + tag + "]") == std::string::npos)
+                    mixed_up++;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    testOk(failed == 0, "%s: all %d exchanges succeeded, %d failed", transport, THREADS * RPCS, failed.load());
+    testOk(mixed_up == 0, "%s: each exchange got the reply to its own request, %d did not", transport,
+           mixed_up.load());
+    testOk(sim.requests() - requests == static_cast<uint64_t>(THREADS * RPCS),
+           "%s: the simulator got every request once", transport);
+    testOk(pool.peak_in_use() == pool.size(), "%s: all %zu contexts were in use at the same time", transport,
+           pool.size());
+    testOk(pool.waits() > 0, "%s: threads waited for a free context %zu times", transport, pool.waits());
+}
+
+MAIN(attocubeIDSIoStressTest) {
+    testPlan(10);
+    IdsSim sim;
+
+    // one asyn IP port, every context connected to it as the driver connects them
+    drvAsynIPPortConfigure("IOSTRESS", sim.address().c_str(), 0, 0, 0);
+    IoContextPool pool(CONTEXTS);
+    for (IoContext& io : pool.contexts()) {
+        if (pasynOctetSyncIO->connect("IOSTRESS", 0, &io.pasynUser, NULL) != asynSuccess)
+            testAbort("cannot connect to IOSTRESS");
+        pasynOctetSyncIO->setInputEos(io.pasynUser, "\n", 1);
+    }
+    stress("asyn", pool, nullptr, sim);
+
+    // one native connection shared by the contexts of a fresh pool, as a native port does
+    std::string error;
+    std::unique_ptr<NativeConnection> native = NativeConnection::create(sim.address(), error);
+    if (!native)
+        testAbort("native transport: %s", error.c_str());
+    IoContextPool native_pool(CONTEXTS);
+    stress("native", native_pool, native.get(), sim);
+
+    return testDone();
+}
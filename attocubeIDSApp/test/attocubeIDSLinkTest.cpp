@@ -0,0 +1,56 @@
+// A port with a second native connection sends the absolute position query ahead on it, so
+// a poll cycle waits for one slow reply instead of two in a row.
+
+#include <epicsThread.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "attocubeIDS.hpp"
+#include "idsSim.h"
+
+static constexpr double REPLY_DELAY = 0.05;
+
+static bool wait_initialized(const AttocubeIDS& ids) {
+    for (int i = 0; i < 200; i++) {
+        if (ids.initialized())
+            return true;
+        epicsThreadSleep(0.05);
+    }
+    return false;
+}
+
+// Poll cycles completed in seconds, counted from the published snapshots
+static uint64_t cycles_in(const AttocubeIDS& ids, double seconds, idsSnapshot& last) {
+    ids.read_snapshot(last);
+    const uint64_t first = last.cycle;
+    epicsThreadSleep(seconds);
+    ids.read_snapshot(last);
+    return last.cycle - first;
+}
+
+MAIN(attocubeIDSLinkTest) {
+    testPlan(6);
+    IdsSim sim;
+    sim.set_delay(REPLY_DELAY);
+    auto* one = new AttocubeIDS(sim.address().c_str(), "LINKTEST1", Transport::Native, 1);
+    auto* two = new AttocubeIDS(sim.address().c_str(), "LINKTEST2", Transport::Native, 2);
+    // a snapshot reader makes every cycle read the displacement and the absolute positions
+    one->add_snapshot_reader();
+    two->add_snapshot_reader();
+    testOk(wait_initialized(*one), "startup handshake on one connection");
+    testOk(wait_initialized(*two), "startup handshake on two connections");
+
+    idsSnapshot last_one{};
+    idsSnapshot last_two{};
+    const uint64_t cycles_one = cycles_in(*one, 1.0, last_one);
+    const uint64_t cycles_two = cycles_in(*two, 1.0, last_two);
+    const uint32_t both = IDS_SNAPSHOT_DISP(0) | IDS_SNAPSHOT_ABS(0);
+    testOk((last_one.valid_mask & both) == both, "one connection: displacement and absolute position read");
+    testOk((last_two.valid_mask & both) == both, "two connections: displacement and absolute position read");
+    testDiag("%llu cycles/s on one connection, %llu on two", static_cast<unsigned long long>(cycles_one),
+             static_cast<unsigned long long>(cycles_two));
+    testOk(cycles_one > 0 && cycles_one < 0.6 / REPLY_DELAY, "one connection waits for both replies in turn");
+    testOk(cycles_two * 10 > cycles_one * 14, "two connections wait for the replies at the same time");
+
+    return testDone();
+}
@@ -0,0 +1,92 @@
+// The JSON-RPC request encoder: string escaping, the decoder reading back what the encoder
+// wrote, and buffers that are too small. Replies that are not well-formed JSON must be told
+// apart from well-formed ones in the wrong layout.
+
+#include <string>
+#include <string_view>
+
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "attocubeIDSRpc.hpp"
+
+static std::string encode_string(std::string_view value) {
+    char buf[512];
+    RpcCodec::Writer w(buf, sizeof(buf));
+    RpcCodec::encode_param(w, value);
+    return std::string(buf, w.size());
+}
+
+static void test_escape(std::string_view value, std::string_view expected, const char* what) {
+    std::string encoded = encode_string(value);
+    testOk(encoded == expected, "%s encoded as %s", what, encoded.c_str());
+}
+
+static RpcCodec::RpcError decode_result(std::string_view result) {
+    std::string reply = R"({"jsonrpc":"2.0","id":1,"result":)" + std::string(result) + "}";
+    Method::AxesDisplacement::result_type values;
+    RpcCodec::RemoteError remote;
+    return RpcCodec::decode<Method::AxesDisplacement>(reply.data(), reply.data() + reply.size(), values,
+                                                      remote);
+}
+
+static void test_decode(std::string_view result, RpcCodec::RpcError expected, const char* what) {
+    testOk(decode_result(result) == expected, "%s: %.*s", what, static_cast<int>(result.size()),
+           result.data());
+}
+
+MAIN(attocubeIDSRpcTest) {
+    testPlan(24);
+
+    test_escape("plain", R"("plain")", "plain text");
+    test_escape("a\"b\\c", R"("a\"b\\c")", "quote and backslash");
+    test_escape("\n\r\t", R"("\n\r\t")", "newline, carriage return and tab");
+    test_escape("\b\f", R"("\b\f")", "backspace and form feed");
+    test_escape(std::string_view("\0\x01\x1f", 3), R"("\u0000\u0001\u001f")", "other control characters");
+    test_escape("\x7f\xc3\xa9", "\"\x7f\xc3\xa9\"", "DEL and UTF-8");
+
+    // every byte a decoder sees in a string comes back unchanged
+    std::string all;
+    for (int c = 0; c < 256; c++)
+        all += static_cast<char>(c);
+    std::string encoded = encode_string(all);
+    bool raw_control = false;
+    for (char c : encoded)
+        raw_control = raw_control || static_cast<unsigned char>(c) < 0x20;
+    testOk(!raw_control, "no control character left unescaped");
+    RpcCodec::JsonString json{std::string_view(encoded).substr(1, encoded.size() - 2), true};
+    std::string decoded;
+    testOk(json.assign_to(decoded) && decoded == all, "all 256 byte values survive encode and decode");
+    testOk(json.equals(all), "JsonString::equals matches the original");
+
+    char buf[128];
+    auto len = RpcCodec::encode<Method::AxisDisplacement>(buf, sizeof(buf), 2);
+    testOk(len && std::string_view(buf, *len) == R"({"jsonrpc":"2.0","id":1,"method":")"
+                                                   R"(com.attocube.ids.displacement.getAxisDisplacement",)"
+                                                   R"("params":[2]})",
+           "request with an int param");
+    len = RpcCodec::encode<Method::AxesDisplacement>(buf, sizeof(buf));
+    testOk(len && std::string_view(buf, *len).find("params") == std::string_view::npos,
+           "request without params has no params array");
+    testOk(!RpcCodec::encode<Method::AxisDisplacement>(buf, 40, 2), "a buffer too small is reported");
+
+    RpcCodec::Writer w(buf, 16);
+    RpcCodec::encode_param(w, "\x01\x02");
+    testOk(!w.overflow() && w.size() == 14, "\\u escapes take 6 characters each");
+    RpcCodec::encode_param(w, "x");
+    testOk(w.overflow(), "writing past the end sets overflow");
+    testOk(w.size() <= 16, "nothing is written past the end");
+
+    using RpcCodec::RpcError;
+    test_decode("[0,1,2,3]", RpcError::None, "the declared layout");
+    test_decode(R"([0,1,2,3,{"a":[1.5e-3,null,"]"]}])", RpcError::None, "extra elements are skipped");
+    test_decode("[0,1,2]", RpcError::Type, "a missing element");
+    test_decode(R"([0,"1",2,3])", RpcError::Type, "a string for a number");
+    test_decode("[0,,2,3]", RpcError::Parse, "an empty element");
+    test_decode("[0 1 2 3]", RpcError::Parse, "a missing separator");
+    test_decode("[0,1,2,3,01]", RpcError::Parse, "an extra element that is not a number");
+    test_decode("[0,1,2,3,[1 2]]", RpcError::Parse, "an extra element with a missing separator");
+    test_decode(R"([0,1,2,3,{"a" 1}])", RpcError::Parse, "an extra object without a colon");
+
+    return testDone();
+}
@@ -0,0 +1,53 @@
+// stop() that times out on a reply the controller is slow to send, then start(): the late
+// poll cycle completes the stop and the port can be started again.
+
+#include <epicsThread.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "attocubeIDS.hpp"
+#include "idsSim.h"
+
+// Waits for the poll cycles to publish cycles more snapshots
+static bool wait_cycles(const AttocubeIDS& ids, unsigned cycles, double timeout) {
+    idsSnapshot snapshot{};
+    ids.read_snapshot(snapshot);
+    const uint64_t first = snapshot.cycle;
+    for (double waited = 0.0; waited < timeout; waited += 0.05) {
+        if (ids.read_snapshot(snapshot) && snapshot.cycle >= first + cycles)
+            return true;
+        epicsThreadSleep(0.05);
+    }
+    return false;
+}
+
+MAIN(attocubeIDSStopTest) {
+    testPlan(7);
+    IdsSim sim;
+    auto* ids = new AttocubeIDS(sim.address().c_str(), "STOPTEST", Transport::Native);
+    // a snapshot reader makes every cycle read the positions, nothing else is of interest
+    ids->add_snapshot_reader();
+
+    bool ready = false;
+    for (int i = 0; i < 100 && !(ready = ids->initialized()); i++)
+        epicsThreadSleep(0.05);
+    testOk(ready, "startup handshake with the simulator");
+    testOk(wait_cycles(*ids, 3, 5.0), "poll cycles run");
+
+    // replies come late but within IO_TIMEOUT, so the cycle is busy and not failing
+    sim.set_delay(0.8 * IO_TIMEOUT);
+    while (sim.held() == 0)
+        epicsThreadSleep(0.01);
+    testOk(!ids->stop(0.1), "stop() times out while a reply is outstanding");
+    testOk(!ids->start(), "start() is refused while the late cycle runs");
+
+    sim.set_delay(0.0);
+    bool started = false;
+    for (int i = 0; i < 100 && !(started = ids->start()); i++)
+        epicsThreadSleep(0.05);
+    testOk(started, "start() works once the late cycle completed the stop");
+    testOk(wait_cycles(*ids, 3, 5.0), "poll cycles run again");
+
+    testOk(ids->stop(SHUTDOWN_TIMEOUT), "stop() without a slow reply");
+    return testDone();
+}
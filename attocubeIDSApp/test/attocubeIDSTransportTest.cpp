@@ -0,0 +1,52 @@
+// The native transport when the controller closes the connection between exchanges: the event
+// loop has to drop the socket instead of spinning on it, and the next exchange reconnects.
+
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+
+#include <epicsThread.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "attocubeIDSIo.hpp"
+#include "attocubeIDSTransport.hpp"
+#include "idsSim.h"
+
+static double process_cpu_seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static asynStatus exchange(NativeConnection& native, IoContext& io) {
+    static const char request[] = R"({"jsonrpc":"2.0","id":1,"method":"com.attocube.test.echo","params":[1]})";
+    std::memcpy(io.out.data(), request, sizeof(request) - 1);
+    return native.write_read(io.out.data(), sizeof(request) - 1, io.in.data(), io.in.size(), 1.0,
+                             &io.nbytesout, &io.nbytesin, &io.eom_reason);
+}
+
+MAIN(attocubeIDSTransportTest) {
+    testPlan(5);
+    IdsSim sim;
+    sim.set_close_after_reply(true);
+    std::string error;
+    std::unique_ptr<NativeConnection> native = NativeConnection::create(sim.address(), error);
+    if (!native)
+        testAbort("native transport: %s", error.c_str());
+    IoContext io;
+
+    testOk(exchange(*native, io) == asynSuccess, "exchange before the simulator closes the connection");
+
+    const double cpu = process_cpu_seconds();
+    epicsThreadSleep(0.5);
+    const double used = process_cpu_seconds() - cpu;
+    testOk(used < 0.1, "%.3f s of CPU in 0.5 s with the connection closed", used);
+
+    testOk(exchange(*native, io) == asynSuccess, "the next exchange reconnects");
+    testOk(native->connects() == 2, "%llu connects", static_cast<unsigned long long>(native->connects()));
+    testOk(native->failures() == 0, "%llu failed exchanges", static_cast<unsigned long long>(native->failures()));
+
+    return testDone();
+}
@@ -0,0 +1,82 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "idsSim.h"
+
+IdsSim::IdsSim() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) || listen(fd, 16) ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len)) {
+        perror("IdsSim");
+        exit(1);
+    }
+    address_ = "127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+    std::thread([this, fd] {
+        while (true) {
+            int client = accept(fd, nullptr, nullptr);
+            if (client >= 0)
+                std::thread([this, client] { serve(client); }).detach();
+        }
+    }).detach();
+}
+
+void IdsSim::serve(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    char buf[1024];
+    std::string request;
+    int depth = 0;
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (depth > 0 || buf[i] == '{')
+                request += buf[i];
+            if (buf[i] == '{') {
+                depth++;
+            } else if (buf[i] == '}' && --depth == 0) {
+                reply(fd, request);
+                request.clear();
+                if (close_after_reply_) {
+                    close(fd);
+                    return;
+                }
+            }
+        }
+    }
+    close(fd);
+}
+
+void IdsSim::reply(int fd, const std::string& request) {
+    requests_++;
+    std::string result;
+    size_t params = request.find("\"params\":[");
+    if (request.find(".system.get") != std::string::npos)
+        result = "[\"IDS3010\"]";
+    else if (request.find("Positions\"") != std::string::npos ||
+             request.find("AxesDisplacement") != std::string::npos)
+        result = "[0,1000,2000,3000]";
+    else if (request.find(".test.echo") != std::string::npos && params != std::string::npos)
+        result = "[0," + request.substr(params + 10, request.find(']', params) - params - 10) + "]";
+    else
+        result = "[0,1]";
+    std::string reply = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":" + result + "}\n";
+
+    if (double delay = delay_) {
+        held_++;
+        std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+        held_--;
+    }
+    send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/// @brief A stand-in for the controller on the loopback interface, for the tests.
+///
+/// Answers each JSON-RPC request with a result of the layout its method declares: a string
+/// for the system queries, errNo and three axis values for the position queries and errNo
+/// and a value for the rest. A method ending in ".test.echo" gets errNo and its params back.
+/// Each client gets a thread of its own.
+class IdsSim {
+  public:
+    /// @brief Starts listening on an ephemeral port, exits the test if it cannot.
+    IdsSim();
+
+    /// @brief The address to connect to, "127.0.0.1:port".
+    const std::string& address() const { return address_; }
+
+    /// @brief Makes every reply wait this long, 0 to reply at once.
+    void set_delay(double seconds) { delay_ = seconds; }
+
+    /// @brief Makes the simulator close each connection after its next reply, as a controller
+    /// that drops its clients does.
+    void set_close_after_reply(bool close) { close_after_reply_ = close; }
+
+    /// @brief Requests received so far.
+    uint64_t requests() const { return requests_; }
+
+    /// @brief Requests whose reply is being delayed right now.
+    int held() const { return held_; }
+
+  private:
+    void serve(int fd);
+    void reply(int fd, const std::string& request);
+
+    std::string address_;
+    std::atomic<double> delay_{0.0};
+    std::atomic<bool> close_after_reply_{false};
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<int> held_{0};
+};
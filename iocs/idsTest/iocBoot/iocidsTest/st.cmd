@@ -13,6 +13,10 @@ drvAsynIPPortConfigure("$(IDS_PORT)", "localhost:9090", 0, 0, 0)
 AttocubeIDSConfig("$(IDS_PORT)", "IDS1")
 
 dbLoadRecords("$(ATTOCUBE_IDS)/db/attocubeIDS.db", "P=$(PREFIX),R=IDS,PORT=IDS1")
+# one per axis the driver was built for, see ATTOCUBE_IDS_NUM_AXES
+dbLoadRecords("$(ATTOCUBE_IDS)/db/attocubeIDSAxis.template", "P=$(PREFIX),R=IDS,PORT=IDS1,AXIS=0,N=1")
+dbLoadRecords("$(ATTOCUBE_IDS)/db/attocubeIDSAxis.template", "P=$(PREFIX),R=IDS,PORT=IDS1,AXIS=1,N=2")
+dbLoadRecords("$(ATTOCUBE_IDS)/db/attocubeIDSAxis.template", "P=$(PREFIX),R=IDS,PORT=IDS1,AXIS=2,N=3")
 
 # asynRecord for debugging
 dbLoadRecords("$(ASYN)/db/asynRecord.db", "P=$(PREFIX), R=asyn_$(IDS_PORT), PORT=$(IDS_PORT), ADDR=0, OMAX=256, IMAX=256")